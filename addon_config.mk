@@ -16,6 +16,8 @@ vs:
 	DLLS_TO_COPY 	+= libs/Structure/libs/vs/x64/Structure.dll
 
 linux64:
+	# no Structure SDK library is shipped for linux yet, frames come from ofx::structure::SyntheticFrameSource
+	ADDON_CFLAGS 	+= -DOFX_STRUCTURE_CORE_NO_SDK
 linuxarmv6l:
 linuxarmv7l:
 msys2:
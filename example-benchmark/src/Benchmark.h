@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+	// counted by the global operator new in main.cpp
+	extern std::atomic<uint64_t> allocCount;
+
+	// failed checks and runs over budget, main() exits with 1 if there were any
+	extern int failures;
+	extern double budgetNs;  // max median ns per frame of every run, 0 = no budget
+
+	// counts a failed check, returns ok
+	inline bool check( bool ok )
+	{
+		if ( !ok ) ++failures;
+		return ok;
+	}
+
+	// floats apart, in units in the last place (0 = equal, +0 and -0 included)
+	inline int64_t ulps( float a, float b )
+	{
+		auto ordered = []( float f ) {
+			int32_t i;
+			std::memcpy( &i, &f, sizeof( i ) );
+			return i < 0 ? int64_t( INT32_MIN ) - i : int64_t( i );
+		};
+		return std::abs( ordered( a ) - ordered( b ) );
+	}
+
+	struct Result
+	{
+		std::string name;
+		size_t frames       = 0;
+		double meanNs       = 0.;
+		double p50Ns        = 0.;
+		double p99Ns        = 0.;
+		double maxNs        = 0.;
+		double bytes        = 0.;  // bytes copied per frame
+		double allocsFrame  = 0.;  // heap allocations per frame
+	};
+
+	// time fn() `frames` times (after `warmup` untimed runs)
+	// prepare() runs before each call and isn't timed or counted
+	inline Result run( const std::string& name, size_t warmup, size_t frames, double bytesPerFrame, const std::function<void()>& prepare, const std::function<void()>& fn )
+	{
+		using clock = std::chrono::steady_clock;
+
+		for ( size_t i = 0; i < warmup; ++i ) {
+			if ( prepare ) prepare();
+			fn();
+		}
+
+		std::vector<double> ns( frames );
+		uint64_t allocs = 0;
+		for ( size_t i = 0; i < frames; ++i ) {
+			if ( prepare ) prepare();
+			uint64_t a0 = allocCount.load();
+			auto t0     = clock::now();
+			fn();
+			auto t1 = clock::now();
+			allocs += allocCount.load() - a0;
+			ns[i] = std::chrono::duration<double, std::nano>( t1 - t0 ).count();
+		}
+
+		Result r;
+		r.name   = name;
+		r.frames = frames;
+		r.bytes  = bytesPerFrame;
+		if ( frames ) {
+			double sum = 0.;
+			for ( double v : ns ) sum += v;
+			r.meanNs      = sum / frames;
+			r.allocsFrame = double( allocs ) / frames;
+			std::sort( ns.begin(), ns.end() );
+			r.p50Ns = ns[frames / 2];
+			r.p99Ns = ns[std::min( frames - 1, frames * 99 / 100 )];
+			r.maxNs = ns.back();
+		}
+		return r;
+	}
+
+	inline void printHeader()
+	{
+		std::printf( "%-32s %8s %12s %12s %12s %12s %12s %10s\n", "benchmark", "frames", "mean ns", "p50 ns", "p99 ns", "max ns", "bytes/frame", "allocs/fr" );
+	}
+
+	inline void print( const Result& r )
+	{
+		const bool overBudget = budgetNs > 0. && !check( r.p50Ns <= budgetNs );
+		std::printf( "%-32s %8zu %12.0f %12.0f %12.0f %12.0f %12.0f %10.2f%s\n", r.name.c_str(), r.frames, r.meanNs, r.p50Ns, r.p99Ns, r.maxNs, r.bytes, r.allocsFrame, overBudget ? "  OVER BUDGET" : "" );
+		std::fflush( stdout );
+	}
+
+}  // namespace bench
@@ -0,0 +1,726 @@
+#include "Benchmark.h"
+#include "ofMain.h"
+#include "ofxStructureCore.h"
+#include "ofxStructureCoreGroup.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+// -----------------------------------------------------------------------
+// headless benchmark of the addon's hot paths, fed by SyntheticFrameSource
+// * ingest:   handleNewFrame(), the sensor thread's cost per frame (shares the frame handle, no copy)
+// * update:   update() converting depth + ir + visible (no textures / point cloud), and lazily reading depth / one ir camera only
+// * ycbcr:    planar visible ingest + update, and the on demand rgb conversion per simd level
+// * points:   cpu depth -> point cloud kernel, per simd level / thread count, and the scalar reference vs the original loop
+// * mm:       float -> 16 bit millimeter depth, and points straight from the millimeter grid
+// * compact:  valid-only point cloud + pixel indices
+// * stride / voxel: downsampling stages
+// * normals:  organized normals, per simd level
+// * mesh:     grid mesher, alternating between two frames so cells keep changing
+// * filter:   depth filter stages, per simd level
+// * temporal: temporal filter, alternating between two frames
+// * register: depth -> visible projection + rgb lookup per point
+// * imu:      one second of 800 Hz samples pushed / drained, a range query, and a threaded drain check
+// * orientation: one second of samples fused, and tracking error at full rate vs app frame rate
+// * imu at frame: interpolated imu readings at a frame timestamp, in each stream's coordinates
+// * latency:  recording into a latency histogram, and its percentiles against the exact ones
+// * frame rate: windowed rate + gap detection over 30 fps timestamps with every 50th frame missing
+// usage: example-benchmark [frames]
+// -----------------------------------------------------------------------
+
+std::atomic<uint64_t> bench::allocCount{0};
+int bench::failures     = 0;
+double bench::budgetNs = 0.;
+
+void* operator new( size_t size )
+{
+	bench::allocCount.fetch_add( 1, std::memory_order_relaxed );
+	if ( void* p = std::malloc( size ? size : 1 ) ) return p;
+	throw std::bad_alloc();
+}
+void* operator new[]( size_t size ) { return operator new( size ); }
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete[]( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, size_t ) noexcept { std::free( p ); }
+void operator delete[]( void* p, size_t ) noexcept { std::free( p ); }
+
+// exposes the protected ingestion path
+class BenchStructureCore : public ofxStructureCore
+{
+public:
+	using ofxStructureCore::handleNewFrame;
+	using ofxStructureCore::handleNewSample;
+	void setStreaming( bool streaming ) { _isStreaming = streaming; }
+};
+
+// frames handed over on demand, the way a source's thread would (sensors that aren't BenchStructureCores, e.g. in a group)
+class ManualFrameSource : public ofx::structure::FrameSource
+{
+public:
+	bool setup( const ofx::structure::Settings& ) override
+	{
+		if ( _delegate ) _delegate->handleSessionEvent( EventType::Ready );
+		return true;
+	}
+	bool startStreaming() override
+	{
+		if ( _delegate ) _delegate->handleSessionEvent( EventType::Streaming );
+		return true;
+	}
+	void stopStreaming() override {}
+	std::string serial() const override { return "manual"; }
+
+	template <typename FrameType>
+	void push( const FrameType& frame )
+	{
+		_delegate->handleNewFrame( frame );
+	}
+};
+
+// a frame as a source would hand it over (the copy is made once, here)
+template <typename PixelType>
+ofx::structure::FrameHandle<PixelType> handleOf( const ofx::structure::FrameData<PixelType>& frame )
+{
+	return ofx::structure::makeFrameHandle<PixelType>( std::make_shared<ofx::structure::FrameData<PixelType>>( frame ) );
+}
+
+//========================================================================
+int main( int argc, char* argv[] )
+{
+	ofInit();
+	ofSetLogLevel( OF_LOG_WARNING );
+
+	const size_t frames = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 300;
+	bench::budgetNs     = argc > 2 ? std::strtod( argv[2], nullptr ) : 0.;
+	const size_t warmup = 10;
+
+	using Settings = ofxStructureCore::Settings;
+	const std::pair<std::string, Settings::DepthResolution> resolutions[] = {
+	    {"QVGA", Settings::DepthResolution::QVGA},
+	    {"VGA", Settings::DepthResolution::VGA},
+	    {"SXGA", Settings::DepthResolution::SXGA}};
+
+	bench::printHeader();
+	for ( auto& res : resolutions ) {
+		Settings settings;
+		settings.structureCore.depthResolution = res.second;
+		settings.addon.useTextures             = false;
+		settings.addon.buildPointCloud         = false;
+
+		ofx::structure::SyntheticFrameSource::Options options;
+		options.realtime = false;
+		auto source      = std::make_unique<ofx::structure::SyntheticFrameSource>( options );
+		auto& synthetic  = *source;
+
+		BenchStructureCore structure;
+		structure.setFrameSource( std::move( source ) );
+		structure.setup( settings );
+		structure.setStreaming( true );  // drive frames by hand instead of start()
+
+		ofx::structure::DepthFrameData depth;
+		ofx::structure::InfraredFrameData ir;
+		ofx::structure::VisibleFrameData visible;
+		synthetic.generateDepth( 0, depth );
+		synthetic.generateInfrared( 0, ir );
+		synthetic.generateVisible( 0, visible );
+		auto depthFrame   = handleOf( depth );
+		auto irFrame      = handleOf( ir );
+		auto visibleFrame = handleOf( visible );
+
+		const std::string prefix = res.first + " ";
+
+		bench::print( bench::run( prefix + "ingest depth", warmup, frames, 0, nullptr, [&]() { structure.handleNewFrame( depthFrame ); } ) );
+		bench::print( bench::run( prefix + "ingest ir", warmup, frames, 0, nullptr, [&]() { structure.handleNewFrame( irFrame ); } ) );
+		bench::print( bench::run( prefix + "ingest visible", warmup, frames, 0, nullptr, [&]() { structure.handleNewFrame( visibleFrame ); } ) );
+
+		bench::print( bench::run(
+		    prefix + "update", warmup, frames, depth.bytes() + ir.bytes() + visible.bytes(),
+		    [&]() {
+			    structure.handleNewFrame( depthFrame );
+			    structure.handleNewFrame( irFrame );
+			    structure.handleNewFrame( visibleFrame );
+		    },
+		    [&]() { structure.update(); } ) );
+
+		// lazy images, the app only reads depth: ir + visible are consumed but never copied
+		{
+			Settings lazySettings         = settings;
+			lazySettings.addon.lazyImages = true;
+			BenchStructureCore lazy;
+			lazy.setFrameSource( std::make_unique<ofx::structure::SyntheticFrameSource>( options ) );
+			lazy.setup( lazySettings );
+			lazy.setStreaming( true );
+			bench::print( bench::run(
+			    prefix + "update lazy depth only", warmup, frames, depth.bytes(),
+			    [&]() {
+				    lazy.handleNewFrame( depthFrame );
+				    lazy.handleNewFrame( irFrame );
+				    lazy.handleNewFrame( visibleFrame );
+			    },
+			    [&]() {
+				    lazy.update();
+				    lazy.getDepthImage();
+			    } ) );
+			auto irStats = lazy.getConversionStats( ofx::structure::Stream::Infrared );
+			std::printf( "%-32s ir converted %llu, skipped %llu\n", ( prefix + "update lazy depth only" ).c_str(), ( unsigned long long )irStats.converted, ( unsigned long long )irStats.skipped );
+
+			// one camera of the BothCameras infrared frame, half rows straight out of the shared buffer
+			using InfraredCamera = ofxStructureCore::InfraredCamera;
+			bench::print( bench::run(
+			    prefix + "update lazy ir left", warmup, frames, ir.bytes() / 2, [&]() { lazy.handleNewFrame( irFrame ); },
+			    [&]() {
+				    lazy.update();
+				    lazy.getInfraredImage( InfraredCamera::Left );
+			    } ) );
+			bench::print( bench::run(
+			    prefix + "update lazy ir left+right", warmup, frames, ir.bytes(), [&]() { lazy.handleNewFrame( irFrame ); },
+			    [&]() {
+				    lazy.update();
+				    lazy.getInfraredImage( InfraredCamera::Left );
+				    lazy.getInfraredImage( InfraredCamera::Right );
+			    } ) );
+			const auto& left = lazy.irLeftImg.getPixels();
+			bool exact       = int( left.getWidth() ) == ir.width / 2;
+			for ( int r = 0; r < ir.height && exact; ++r ) {
+				exact = std::memcmp( &left[size_t( r ) * left.getWidth()], ir.data() + size_t( r ) * ir.width + ir.width / 2, left.getWidth() * sizeof( uint16_t ) ) == 0;
+			}
+			std::printf( "%-32s %s\n", ( prefix + "update lazy ir left" ).c_str(), bench::check( exact ) ? "matches frame" : "MISMATCH vs frame" );
+		}
+
+		// planar visible frames: update copies the luma plane instead of rgb, rgb is converted on demand
+		{
+			Settings planarSettings            = settings;
+			planarSettings.addon.visibleYCbCr = true;
+			ofx::structure::SyntheticFrameSource planarSource( options );
+			planarSource.setup( planarSettings );
+			ofx::structure::VisibleFrameData planar;
+			planarSource.generateVisible( 0, planar );
+			auto planarFrame = handleOf( planar );
+
+			bench::print( bench::run( prefix + "ingest visible ycbcr", warmup, frames, 0, nullptr, [&]() { structure.handleNewFrame( planarFrame ); } ) );
+			bench::print( bench::run(
+			    prefix + "update visible ycbcr", warmup, frames, planar.width * planar.height,
+			    [&]() { structure.handleNewFrame( planarFrame ); },
+			    [&]() { structure.update(); } ) );
+
+			std::vector<uint8_t> expected( planar.width * planar.height * 3 ), rgb( expected.size() );
+			ofx::structure::ThreadPool pool;
+			ofx::structure::setSimdLevel( ofx::structure::SimdLevel::Scalar );
+			bench::print( bench::run( prefix + "ycbcr->rgb Scalar", warmup, frames, rgb.size(), nullptr, [&]() {
+				ofx::structure::yCbCrToRgb( planar.data(), planar.chroma(), planar.width, expected.data(), 0, planar.height );
+			} ) );
+			ofx::structure::setSimdLevel( ofx::structure::detectSimdLevel() );
+			const std::string name = prefix + "ycbcr->rgb " + ofx::structure::to_string( ofx::structure::getSimdLevel() ) + " x" + std::to_string( pool.size() );
+			bench::print( bench::run( name, warmup, frames, rgb.size(), nullptr, [&]() {
+				ofx::structure::yCbCrToRgb( planar.data(), planar.chroma(), planar.width, planar.height, rgb.data(), pool );
+			} ) );
+			bool exact = rgb == expected;
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// cpu point cloud, every simd level this machine supports, checked bit for bit against the scalar reference
+		// and the reference within maxUlps of the original (pre ray table) loop
+		ofx::structure::RayTable rays;
+		rays.update( depth.width, depth.height, depth.intrinsics );
+		std::vector<glm::vec3> reference( depth.size() ), points( depth.size() );
+		ofx::structure::depthToPointsScalar( depth.data(), rays, reference.data() );
+		bench::print( bench::run( prefix + "points Scalar", warmup, frames, points.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+			ofx::structure::depthToPointsScalar( depth.data(), rays, points.data() );
+		} ) );
+		{
+			// the original loop divided after the multiply, depth * ( c - cx ) / fx, the ray table multiplies by ( c - cx ) / fx,
+			// so the scalar reference only differs from it by rounding
+			const int maxUlps = 2;
+			const auto& in    = depth.intrinsics;
+			int64_t worst     = 0;
+			for ( int r = 0; r < depth.height; r++ ) {
+				for ( int c = 0; c < depth.width; c++ ) {
+					const int i   = r * depth.width + c;
+					const float d = depth.data()[i];
+					const float x = d * ( c - in.cx ) / in.fx * -1.;
+					const float y = d * ( r - in.cy ) / in.fy * -1.;
+					worst         = std::max( {worst, bench::ulps( x, reference[i].x ), bench::ulps( y, reference[i].y ), bench::ulps( d, reference[i].z )} );
+				}
+			}
+			std::printf( "%-32s %s, %lld ulp max\n", ( prefix + "points Scalar" ).c_str(), bench::check( worst <= maxUlps ) ? "matches original loop" : "MISMATCH vs original loop", ( long long )worst );
+		}
+		const auto detected = ofx::structure::detectSimdLevel();
+		for ( auto level : {ofx::structure::SimdLevel::SSE2, ofx::structure::SimdLevel::AVX2, ofx::structure::SimdLevel::NEON} ) {
+			ofx::structure::setSimdLevel( level );
+			if ( ofx::structure::getSimdLevel() != level ) continue;  // unsupported here
+			const std::string name = prefix + "points " + ofx::structure::to_string( level );
+			bench::print( bench::run( name, warmup, frames, points.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+				ofx::structure::depthToPoints( depth.data(), rays, points.data() );
+			} ) );
+			bool exact = std::memcmp( points.data(), reference.data(), points.size() * sizeof( glm::vec3 ) ) == 0;
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+		ofx::structure::setSimdLevel( detected );
+
+		// row parallel, output must not depend on the thread count
+		for ( size_t threads : {size_t( 2 ), size_t( 4 ), size_t( std::thread::hardware_concurrency() )} ) {
+			ofx::structure::ThreadPool pool( threads );
+			const std::string name = prefix + "points " + ofx::structure::to_string( detected ) + " x" + std::to_string( pool.size() );
+			bench::print( bench::run( name, warmup, frames, points.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+				ofx::structure::depthToPoints( depth.data(), rays, points.data(), pool );
+			} ) );
+			bool exact = std::memcmp( points.data(), reference.data(), points.size() * sizeof( glm::vec3 ) ) == 0;
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// 16 bit millimeters: rounding per simd level, and points from the uint16_t grid vs the float cloud of the widened depth
+		{
+			std::vector<uint16_t> expected( depth.size() ), mm( depth.size() );
+			std::vector<float> widened( depth.size() );
+			std::vector<glm::vec3> mmReference( depth.size() );
+			ofx::structure::setSimdLevel( ofx::structure::SimdLevel::Scalar );
+			bench::print( bench::run( prefix + "depth->mm Scalar", warmup, frames, mm.size() * sizeof( uint16_t ), nullptr, [&]() {
+				ofx::structure::depthToMillimeters( depth.data(), expected.data(), expected.size() );
+			} ) );
+			ofx::structure::millimetersToDepth( expected.data(), widened.data(), widened.size() );
+			ofx::structure::depthToPointsScalar( widened.data(), rays, mmReference.data() );
+			ofx::structure::setSimdLevel( detected );
+			std::string name = prefix + "depth->mm " + ofx::structure::to_string( detected );
+			bench::print( bench::run( name, warmup, frames, mm.size() * sizeof( uint16_t ), nullptr, [&]() {
+				ofx::structure::depthToMillimeters( depth.data(), mm.data(), mm.size() );
+			} ) );
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( mm == expected ) ? "matches scalar" : "MISMATCH vs scalar" );
+			name = prefix + "points mm " + ofx::structure::to_string( detected );
+			bench::print( bench::run( name, warmup, frames, points.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+				ofx::structure::depthToPoints( mm.data(), rays, points.data() );
+			} ) );
+			bool exact = std::memcmp( points.data(), mmReference.data(), points.size() * sizeof( glm::vec3 ) ) == 0;
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// valid points only, must equal the full cloud at the reported pixels
+		{
+			ofx::structure::ThreadPool pool;
+			ofx::structure::PointCompactor compactor;
+			std::vector<glm::vec3> compact( depth.size() );
+			std::vector<uint32_t> indices( depth.size() );
+			size_t n = 0;
+			bench::print( bench::run( prefix + "compact", warmup, frames, depth.bytes(), nullptr, [&]() {
+				n = compactor.count( depth.data(), rays, pool );
+				compactor.write( depth.data(), rays, compact.data(), indices.data(), pool );
+			} ) );
+			bool exact = true;
+			for ( size_t i = 0; i < n && exact; ++i ) {
+				exact = std::memcmp( &compact[i], &reference[indices[i]], sizeof( glm::vec3 ) ) == 0 && ( i == 0 || indices[i] > indices[i - 1] );
+			}
+			std::printf( "%-32s %s, %zu of %zu points (%.0f%%)\n", ( prefix + "compact" ).c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar", n, depth.size(), 100. * n / depth.size() );
+		}
+
+		// stride 2: decimate + unproject, must equal the full cloud at the kept pixels
+		{
+			ofx::structure::ThreadPool pool;
+			const int stride = 2;
+			const int w      = ofx::structure::decimatedSize( depth.width, stride );
+			const int h      = ofx::structure::decimatedSize( depth.height, stride );
+			ofx::structure::RayTable strideRays;
+			strideRays.update( w, h, depth.intrinsics, stride );
+			std::vector<float> decimated( w * h );
+			std::vector<glm::vec3> strided( w * h );
+			bench::print( bench::run( prefix + "stride 2", warmup, frames, depth.bytes(), nullptr, [&]() {
+				ofx::structure::decimateDepth( depth.data(), depth.width, depth.height, stride, decimated.data(), pool );
+				ofx::structure::depthToPoints( decimated.data(), strideRays, strided.data(), pool );
+			} ) );
+			bool exact = true;
+			for ( int r = 0; r < h && exact; ++r ) {
+				for ( int c = 0; c < w && exact; ++c ) {
+					exact = std::memcmp( &strided[r * w + c], &reference[( r * stride ) * depth.width + c * stride], sizeof( glm::vec3 ) ) == 0;
+				}
+			}
+			std::printf( "%-32s %s\n", ( prefix + "stride 2" ).c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// voxel grid over the full cloud, output must not depend on the thread count
+		{
+			const float leaf = 20.f;  // mm
+			ofx::structure::ThreadPool single( 1 ), pool;
+			ofx::structure::VoxelGrid grid;
+			std::vector<glm::vec3> expected( reference.size() ), voxels( reference.size() );
+			size_t n        = grid.filter( reference.data(), reference.size(), leaf, expected.data(), single );
+			const auto name = prefix + "voxel 20mm x" + std::to_string( pool.size() );
+			bench::print( bench::run( name, warmup, frames, reference.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+				grid.filter( reference.data(), reference.size(), leaf, voxels.data(), pool );
+			} ) );
+			bool exact = std::memcmp( voxels.data(), expected.data(), n * sizeof( glm::vec3 ) ) == 0;
+			std::printf( "%-32s %s, %zu voxels\n", name.c_str(), bench::check( exact ) ? "matches x1" : "MISMATCH vs x1", n );
+		}
+
+		// normals, every simd level checked bit for bit against the scalar loop
+		{
+			ofx::structure::ThreadPool pool;
+			std::vector<glm::vec3> expected( depth.size() ), normals( depth.size() );
+			ofx::structure::depthToNormalsScalar( depth.data(), rays, expected.data() );
+			bench::print( bench::run( prefix + "normals Scalar", warmup, frames, normals.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+				ofx::structure::depthToNormalsScalar( depth.data(), rays, normals.data() );
+			} ) );
+			for ( auto level : {ofx::structure::SimdLevel::SSE2, ofx::structure::SimdLevel::AVX2, ofx::structure::SimdLevel::NEON} ) {
+				ofx::structure::setSimdLevel( level );
+				if ( ofx::structure::getSimdLevel() != level ) continue;
+				const std::string name = prefix + "normals " + ofx::structure::to_string( level ) + " x" + std::to_string( pool.size() );
+				bench::print( bench::run( name, warmup, frames, normals.size() * sizeof( glm::vec3 ), nullptr, [&]() {
+					ofx::structure::depthToNormals( depth.data(), rays, normals.data(), pool );
+				} ) );
+				bool exact = std::memcmp( normals.data(), expected.data(), normals.size() * sizeof( glm::vec3 ) ) == 0;
+				std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+			}
+			ofx::structure::setSimdLevel( detected );
+		}
+
+		// mesh, simd result checked against a scalar run over the same frames
+		{
+			ofx::structure::ThreadPool pool;
+			ofx::structure::DepthFrameData next;
+			synthetic.generateDepth( 1, next );
+			const float* frames2[2] = {depth.data(), next.data()};
+			auto meshRun            = [&]( ofx::structure::GridMesher& mesh, size_t count ) {
+                for ( size_t i = 0; i < count; ++i ) mesh.update( frames2[i & 1], depth.width, depth.height, 30.f, pool );
+			};
+
+			ofx::structure::setSimdLevel( ofx::structure::SimdLevel::Scalar );
+			ofx::structure::GridMesher expected;
+			meshRun( expected, 3 );
+			ofx::structure::setSimdLevel( detected );
+
+			ofx::structure::GridMesher mesh;
+			size_t frame    = 0;
+			const auto name = prefix + "mesh " + ofx::structure::to_string( detected ) + " x" + std::to_string( pool.size() );
+			bench::print( bench::run( name, warmup, frames, depth.bytes(), nullptr, [&]() {
+				mesh.update( frames2[frame++ & 1], depth.width, depth.height, 30.f, pool );
+			} ) );
+			bench::print( bench::run( prefix + "mesh unchanged", warmup, frames, depth.bytes(), nullptr, [&]() {
+				mesh.update( depth.data(), depth.width, depth.height, 30.f, pool );
+			} ) );
+			ofx::structure::GridMesher check;
+			meshRun( check, 3 );
+			bool exact = check.indices() == expected.indices();
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// depth filters, simd checked bit for bit against the scalar loop
+		for ( auto type : {ofx::structure::DepthFilterStage::Median3, ofx::structure::DepthFilterStage::Median5, ofx::structure::DepthFilterStage::Bilateral} ) {
+			ofx::structure::ThreadPool pool;
+			ofx::structure::DepthFilterStage stage;
+			stage.type = type;
+			std::vector<float> expected( depth.size() ), filtered( depth.size() );
+			const std::string name = prefix + "filter " + ofx::structure::to_string( type );
+			ofx::structure::setSimdLevel( ofx::structure::SimdLevel::Scalar );
+			bench::print( bench::run( name + " Scalar", warmup, frames, depth.bytes(), nullptr, [&]() {
+				ofx::structure::applyDepthFilter( stage, depth.data(), expected.data(), depth.width, depth.height, 0, depth.height );
+			} ) );
+			ofx::structure::setSimdLevel( detected );
+			bench::print( bench::run( name + " " + ofx::structure::to_string( detected ), warmup, frames, depth.bytes(), nullptr, [&]() {
+				pool.parallelFor( 0, depth.height, 8, [&]( size_t b, size_t e ) {
+					ofx::structure::applyDepthFilter( stage, depth.data(), filtered.data(), depth.width, depth.height, int( b ), int( e ) );
+				} );
+			} ) );
+			bool exact = std::memcmp( filtered.data(), expected.data(), filtered.size() * sizeof( float ) ) == 0;
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// temporal filter, simd state + output checked bit for bit against a scalar run over the same frames
+		{
+			ofx::structure::ThreadPool pool;
+			ofx::structure::DepthFrameData next;
+			synthetic.generateDepth( 1, next );
+			for ( size_t i = 0; i < next.size(); i += 7 ) next.data()[i] = 0.f;  // dropouts, so pixels get held
+			const float* frames2[2] = {depth.data(), next.data()};
+			ofx::structure::TemporalFilterParams params;
+			params.enabled = true;
+			auto temporalRun = [&]( std::vector<float>& out, std::vector<float>& state, std::vector<uint8_t>& age ) {
+				state.assign( depth.size(), 0.f );
+				age.assign( depth.size(), 0 );
+				for ( size_t i = 0; i < 5; ++i ) {
+					out.assign( frames2[i & 1], frames2[i & 1] + depth.size() );
+					ofx::structure::applyTemporalFilter( params, out.data(), state.data(), age.data(), depth.width, 0, depth.height );
+				}
+			};
+			std::vector<float> expected, expectedState, out, state;
+			std::vector<uint8_t> expectedAge, age;
+			ofx::structure::setSimdLevel( ofx::structure::SimdLevel::Scalar );
+			temporalRun( expected, expectedState, expectedAge );
+			ofx::structure::setSimdLevel( detected );
+			temporalRun( out, state, age );
+			bool exact = out == expected && state == expectedState && age == expectedAge;
+
+			ofx::structure::TemporalFilter filter;
+			filter.params = params;
+			std::vector<float> filtered( depth.size() );
+			size_t frame    = 0;
+			const auto name = prefix + "temporal " + ofx::structure::to_string( detected ) + " x" + std::to_string( pool.size() );
+			bench::print( bench::run(
+			    name, warmup, frames, depth.bytes(),
+			    [&]() { std::memcpy( filtered.data(), frames2[frame++ & 1], depth.bytes() ); },
+			    [&]() { filter.apply( filtered.data(), depth.width, depth.height, pool ); } ) );
+			std::printf( "%-32s %s\n", name.c_str(), bench::check( exact ) ? "matches scalar" : "MISMATCH vs scalar" );
+		}
+
+		// color registration, every point projected into the visible frame and colored
+		{
+			ofx::structure::ThreadPool pool;
+			ofx::structure::ColorRegistration registration;
+			registration.update( rays, depth.visiblePose, visible.intrinsics );
+			std::vector<glm::vec2> uvs( depth.size() );
+			std::vector<ofFloatColor> colors( depth.size() );
+			const auto name = prefix + "register x" + std::to_string( pool.size() );
+			bench::print( bench::run( name, warmup, frames, colors.size() * sizeof( ofFloatColor ), nullptr, [&]() {
+				registration.project( depth.data(), nullptr, depth.size(), uvs.data(), pool );
+				ofx::structure::ColorRegistration::sample( uvs.data(), uvs.size(), visible.data(), visible.width, visible.height, colors.data(), pool );
+			} ) );
+			size_t colored = std::count_if( colors.begin(), colors.end(), []( const ofFloatColor& c ) { return c.a > 0.f; } );
+			std::printf( "%-32s %zu of %zu points colored (%.0f%%)\n", name.c_str(), colored, colors.size(), 100. * colored / colors.size() );
+		}
+	}
+
+	// imu queue, the sdk thread pushes every sample while the app drains / queries
+	{
+		using ImuSample = ofx::structure::ImuSample;
+		ofx::structure::ImuQueue queue( 4096 );
+		const size_t rate = 800;
+		ImuSample sample;
+		double t = 0.;
+		auto pushSecond = [&]() {
+			for ( size_t i = 0; i < rate; ++i ) {
+				sample.timestamp = t += 1. / rate;
+				queue.push( sample );
+			}
+		};
+		std::vector<ImuSample> out;
+		out.reserve( queue.capacity() );
+		bench::print( bench::run( "imu push x800", warmup, frames, rate * sizeof( ImuSample ), nullptr, pushSecond ) );
+		bench::print( bench::run( "imu drain x800", warmup, frames, rate * sizeof( ImuSample ), pushSecond, [&]() { queue.drain( out ); } ) );
+		bench::print( bench::run( "imu range 33ms", warmup, frames, 0, nullptr, [&]() { queue.range( t - 0.5, t - 0.5 + 1. / 30., out ); } ) );
+		std::printf( "%-32s %zu samples\n", "imu range 33ms", out.size() );
+
+		// producer flat out on its own thread: drained samples stay in order, drained + lost covers every push
+		ofx::structure::ImuQueue threaded( 1024 );
+		const uint64_t total = 1000000;
+		std::thread producer( [&]() {
+			ImuSample s;
+			for ( uint64_t i = 1; i <= total; ++i ) {
+				s.timestamp = double( i );
+				threaded.push( s );
+			}
+		} );
+		bool ordered = true;
+		double last  = 0.;
+		for ( bool done = false; !done; ) {
+			done = threaded.stats().pushed == total;  // one more drain after the last push
+			threaded.drain( out );
+			for ( auto& s : out ) {
+				ordered = ordered && s.timestamp > last;
+				last    = s.timestamp;
+			}
+		}
+		producer.join();
+		const auto stats = threaded.stats();
+		const bool exact = ordered && stats.drained + stats.lost == total;
+		std::printf( "%-32s %s, %llu drained, %llu lost\n", "imu threaded drain", bench::check( exact ) ? "in order" : "MISMATCH", ( unsigned long long )stats.drained, ( unsigned long long )stats.lost );
+	}
+
+	// orientation fusion on synthetic samples (rolling +-10 degrees at 0.5 Hz)
+	{
+		using ImuSample = ofx::structure::ImuSample;
+		ofx::structure::SyntheticFrameSource synthetic;
+		const double rate = 800.;
+		uint64_t n        = 0;
+		ofx::structure::OrientationFilter filter;
+		auto fuseSecond = [&]() {
+			for ( int i = 0; i < int( rate ); ++i, ++n ) {
+				filter.add( synthetic.generateImu( ImuSample::Type::Accelerometer, n / rate ) );
+				filter.add( synthetic.generateImu( ImuSample::Type::Gyroscope, n / rate ) );
+			}
+		};
+		bench::print( bench::run( "orientation x800", warmup, frames, 0, nullptr, fuseSecond ) );
+
+		// worst angle between the fused gravity and the true one over seconds 5 - 10, fusing every `every`-th sample
+		auto trackingError = [&]( int every ) {
+			ofx::structure::OrientationFilter f;
+			double worst = 0.;
+			for ( int i = 0; i < int( rate * 10. ); i += every ) {
+				const double t = i / rate;
+				f.add( synthetic.generateImu( ImuSample::Type::Accelerometer, t ) );
+				f.add( synthetic.generateImu( ImuSample::Type::Gyroscope, t ) );
+				if ( t < 5. ) continue;
+				const double roll = 10. * PI / 180. * std::sin( PI * t );
+				const glm::vec3 g = f.get().gravity;
+				const double c    = std::min( 1., std::max( -1., -std::sin( roll ) * g.x - std::cos( roll ) * g.y ) );
+				worst             = std::max( worst, std::acos( c ) * 180. / PI );
+			}
+			return worst;
+		};
+		const double full = trackingError( 1 ), sparse = trackingError( 27 );
+		const bool exact  = full < 0.5 && sparse < 3.;
+		std::printf( "%-32s %s, %.3f deg max error at 800 Hz, %.3f deg at 30 Hz\n", "orientation tracking", bench::check( exact ) ? "tracks gravity" : "MISMATCH vs gravity", full, sparse );
+	}
+
+	// imu state at frame timestamps, from a full queue (one second more than it holds)
+	{
+		using ImuSample = ofx::structure::ImuSample;
+		using Stream    = ofx::structure::Stream;
+		Settings settings;
+		settings.structureCore.accelerometerEnabled = true;
+		settings.structureCore.gyroscopeEnabled     = true;
+		ofx::structure::SyntheticFrameSource::Options options;
+		options.realtime = false;
+		auto source      = std::make_unique<ofx::structure::SyntheticFrameSource>( options );
+		auto& synthetic  = *source;
+		BenchStructureCore structure;
+		structure.setFrameSource( std::move( source ) );
+		structure.setup( settings );
+		const double rate  = 800.;
+		const int nSamples = int( structure.getImuQueue( ImuSample::Type::Gyroscope ).capacity() + rate );
+		for ( int i = 0; i < nSamples; ++i ) {
+			structure.handleNewSample( synthetic.generateImu( ImuSample::Type::Accelerometer, i / rate ) );
+			structure.handleNewSample( synthetic.generateImu( ImuSample::Type::Gyroscope, i / rate ) );
+		}
+		const double newest = ( nSamples - 1 ) / rate;
+		size_t frame        = 0;
+		bench::print( bench::run( "imu at frame x3", warmup, frames, 0, nullptr, [&]() {
+			const double t = newest - 2. + ( frame++ % 60 ) / 30.;  // 30 fps frames over the last 2 seconds
+			structure.getImuAt( t, Stream::Depth );
+			structure.getImuAt( t, Stream::Infrared );
+			structure.getImuAt( t, Stream::Visible );
+		} ) );
+
+		// halfway between two samples: the mean of both, the synthetic imu sits at the depth camera (identity extrinsics)
+		const double t0  = newest - 1.;
+		const auto a0    = synthetic.generateImu( ImuSample::Type::Gyroscope, t0 );
+		const auto a1    = synthetic.generateImu( ImuSample::Type::Gyroscope, t0 + 1. / rate );
+		const auto state = structure.getImuAt( t0 + 0.5 / rate, Stream::Visible );
+		const bool exact = state.interpolated && std::fabs( state.rotationRate.z - float( 0.5 * ( a0.z + a1.z ) ) ) < 1e-6f;
+		const bool stale = !structure.getImuAt( newest + 1., Stream::Depth ).interpolated && !structure.getImuAt( 0., Stream::Depth ).interpolated;
+		std::printf( "%-32s %s\n", "imu at frame", bench::check( exact && stale ) ? "matches samples" : "MISMATCH vs samples" );
+	}
+
+	// latency histogram, 1000 latencies spread over 1 - 100 ms per frame
+	{
+		ofx::structure::LatencyHistogram histogram;
+		std::vector<double> latencies( 1000 );
+		for ( size_t i = 0; i < latencies.size(); ++i ) latencies[i] = 0.001 + 0.099 * ( ( i * 7919 ) % latencies.size() ) / latencies.size();
+		bench::print( bench::run( "latency record x1000", warmup, frames, 0, nullptr, [&]() {
+			for ( double l : latencies ) histogram.record( l );
+		} ) );
+		bench::print( bench::run( "latency stats", warmup, frames, 0, nullptr, [&]() { histogram.stats(); } ) );
+
+		// within the 1/32 bucket width of the exact percentiles
+		std::sort( latencies.begin(), latencies.end() );
+		const auto stats = histogram.stats();
+		auto close       = [&]( double ms, double p ) {
+			const double exact = latencies[size_t( p * ( latencies.size() - 1 ) )] * 1e3;
+			return std::fabs( ms - exact ) <= exact / 32.;
+		};
+		const bool exact = close( stats.p50, 0.50 ) && close( stats.p95, 0.95 ) && close( stats.p99, 0.99 ) && std::fabs( stats.max - latencies.back() * 1e3 ) < 1e-3;
+		std::printf( "%-32s %s, p50 %.2f p95 %.2f p99 %.2f max %.2f ms\n", "latency stats", bench::check( exact ) ? "matches exact" : "MISMATCH vs exact", stats.p50, stats.p95, stats.p99, stats.max );
+	}
+
+	// frame rate, one add() per frame
+	{
+		ofx::structure::FrameRateEstimator rate;
+		rate.reset( 30. );
+		uint64_t n = 0, missing = 0;
+		auto next  = [&]() {
+			if ( ++n % 50 == 0 ) {
+				++missing;  // every 50th frame never arrives
+				++n;
+			}
+			return n / 30.;
+		};
+		bench::print( bench::run( "frame rate add", warmup, frames, 0, nullptr, [&]() { rate.add( next() ); } ) );
+
+		// 10 s of frames: every missing one is a gap, the window rate is what arrived
+		rate.reset( 30. );
+		n = missing = 0;
+		while ( n < 300 ) rate.add( next() );
+		const bool exact = std::fabs( rate.fps() - 30. * 49. / 50. ) < 1. && rate.gaps() == missing && rate.missed() == missing;
+		std::printf( "%-32s %s, %.2f fps, %llu gaps, %llu missed\n", "frame rate", bench::check( exact ) ? "matches expected" : "MISMATCH vs expected", rate.fps(), ( unsigned long long )rate.gaps(), ( unsigned long long )rate.missed() );
+	}
+
+	// sensor group, 4 realtime synthetic sensors brought up together and updated side by side (no gl)
+	{
+		using Stream = ofx::structure::Stream;
+		Settings settings;
+		settings.addon.useTextures     = false;
+		settings.addon.buildPointCloud = false;
+		ofxStructureCoreGroup group;
+		group.setFrameSourceFactory( []( size_t ) { return std::make_unique<ofx::structure::SyntheticFrameSource>(); } );
+		bool ok = group.setup( std::vector<Settings>( 4, settings ), 2.f );
+		std::printf( "%-32s %.2f ms\n", "group bring-up x4", group.getStartupTime() * 1e3 );
+
+		// every sensor's depth frames picked up by the one update() call
+		const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds( 500 );
+		while ( std::chrono::steady_clock::now() < end ) {
+			group.update();
+			std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+		}
+		group.stop();
+		for ( size_t i = 0; i < group.size(); ++i ) {
+			ok = ok && group.getStartup( i ).ok && group[i].getFrameRateStats( Stream::Depth ).consumedFps > 0. && group[i].getDepthImage().isAllocated();
+		}
+		std::printf( "%-32s %s\n", "group update", bench::check( ok ) ? "matches expected" : "MISMATCH vs expected" );
+	}
+
+	// the same 4 sensors updated one after another (each with an all-cores pool) vs. by a group (a share of the cores each)
+	{
+		Settings settings;
+		settings.addon.useTextures       = false;
+		settings.addon.compactPointCloud = true;  // cpu point cloud
+		settings.addon.computeNormals    = true;
+		ofx::structure::SyntheticFrameSource synthetic;
+		synthetic.setup( settings );
+		ofx::structure::DepthFrameData depth;
+		ofx::structure::VisibleFrameData visible;
+		synthetic.generateDepth( 0, depth );
+		synthetic.generateVisible( 0, visible );
+		const auto depthFrame   = handleOf( depth );
+		const auto visibleFrame = handleOf( visible );
+
+		const size_t n = 4;
+		std::vector<ManualFrameSource*> serialSources, groupSources;
+		std::vector<std::unique_ptr<ofxStructureCore>> serial;
+		for ( size_t i = 0; i < n; ++i ) {
+			auto source = std::make_unique<ManualFrameSource>();
+			serialSources.push_back( source.get() );
+			serial.emplace_back( new ofxStructureCore() );
+			serial.back()->setFrameSource( std::move( source ) );
+			serial.back()->setup( settings );
+			serial.back()->start( 1.f );
+		}
+		ofxStructureCoreGroup group;
+		group.setFrameSourceFactory( [&]( size_t ) {
+			auto source = std::make_unique<ManualFrameSource>();
+			groupSources.push_back( source.get() );
+			return source;
+		} );
+		bool ok = group.setup( std::vector<Settings>( n, settings ), 1.f );
+
+		auto feed = [&]( const std::vector<ManualFrameSource*>& sources ) {
+			for ( auto* source : sources ) {
+				source->push( visibleFrame );
+				source->push( depthFrame );
+			}
+		};
+		bench::print( bench::run( "serial update x4", warmup, frames, 0, [&]() { feed( serialSources ); }, [&]() {
+			for ( auto& sensor : serial ) sensor->update();
+		} ) );
+		bench::print( bench::run( "group update x4", warmup, frames, 0, [&]() { feed( groupSources ); }, [&]() { group.update(); } ) );
+
+		// same frames, same clouds, however the work was split
+		for ( size_t i = 0; i < n; ++i ) {
+			const auto& a      = group[i].pointcloud;
+			const auto& b      = serial[i]->pointcloud;
+			const bool points  = !a.points.empty() && a.points.size() == b.points.size() && std::memcmp( a.points.data(), b.points.data(), a.points.size() * sizeof( glm::vec3 ) ) == 0;
+			const bool normals = a.normals.size() == b.normals.size() && std::memcmp( a.normals.data(), b.normals.data(), a.normals.size() * sizeof( glm::vec3 ) ) == 0;
+			ok                 = ok && points && normals;
+		}
+		std::printf( "%-32s %s, %zu thread(s) per sensor\n", "group point clouds", bench::check( ok ) ? "matches serial" : "MISMATCH vs serial", group[0].getThreadPool().size() );
+	}
+	if ( bench::failures ) {
+		std::printf( "\n%d check(s) failed\n", bench::failures );
+	}
+	return bench::failures ? 1 : 0;
+}
@@ -1,21 +1,112 @@
 #include "ofxStructureCore.h"
 
+namespace {
+	// packed copy of a frame's pixels in row blocks across the pool, only allocates when the size changes
+	template <typename PixelType>
+	void toPixels( const ofx::structure::FrameView<PixelType>& frame, ofPixels_<PixelType>& pixels, ofx::structure::ThreadPool& pool )
+	{
+		if ( int( pixels.getWidth() ) != frame.width || int( pixels.getHeight() ) != frame.height || int( pixels.getNumChannels() ) != frame.channels ) {
+			pixels.allocate( frame.width, frame.height, frame.channels );
+		}
+		PixelType* dst = pixels.getData();
+		pool.parallelFor( 0, frame.height, 64, [&]( size_t b, size_t e ) { ofx::structure::copyRows( frame, dst, int( b ), int( e ) ); } );
+	}
+
+	// upload with rect tex coords (the getters can be called outside update())
+	template <typename PixelType>
+	void updateImage( ofImage_<PixelType>& img )
+	{
+		if ( !img.isUsingTexture() ) {
+			img.update();  // pixels only, no gl state to touch
+			return;
+		}
+		bool wasUsingArbTex = ofGetUsingArbTex();
+		ofEnableArbTex();
+		img.update();
+		if ( !wasUsingArbTex ) {
+			ofDisableArbTex();
+		}
+	}
+}  // namespace
+
 ofxStructureCore::ofxStructureCore()
+    : _pool( new ofx::structure::ThreadPool( 1 ) )
+{
+#ifndef OFX_STRUCTURE_CORE_NO_SDK
+	setFrameSource( std::make_unique<ofx::structure::SensorFrameSource>() );
+#else
+	setFrameSource( std::make_unique<ofx::structure::SyntheticFrameSource>() );  // no Structure SDK in this build
+#endif
+}
+
+ofxStructureCore::~ofxStructureCore()
+{
+	// stop source threads before our buffers go away
+	_source->stopStreaming();
+	_source->setDelegate( nullptr );
+}
+
+void ofxStructureCore::setFrameSource( std::unique_ptr<FrameSource> source )
 {
-	_captureSession.setDelegate( this );
+	if ( _isInit ) {
+		ofLogWarning( ofx_module() ) << "Changing frame source after setup(), call setup() again before start().";
+		stop();
+		_isInit = _isReady = false;
+	}
+	if ( _source ) {
+		_source->setDelegate( nullptr );
+	}
+	_source = std::move( source );
+	_source->setDelegate( this );
 }
 
 bool ofxStructureCore::setup( const Settings& settings )
 {
+	// the queues, filters and estimators below are fed by the source's threads, reconfigure them only once it's stopped
+	if ( _isInit ) {
+		stop();
+	}
 	_settings      = settings;
 	_isInit        = false;
 	_streamOnReady = false;  // wait until user calls start() to startStreaming()
-	if ( _captureSession.startMonitoring( settings ) ) {
+	_depthHistory.setCapacity( settings.addon.depthHistorySize );
+	_irHistory.setCapacity( settings.addon.infraredHistorySize );
+	_visibleHistory.setCapacity( settings.addon.visibleHistorySize );
+	_accelQueue.setCapacity( settings.addon.imuQueueSize );
+	_gyroQueue.setCapacity( settings.addon.imuQueueSize );
+	_orientation.params = settings.addon.orientation;
+	_orientation.reset();
+	_pool.reset( new ofx::structure::ThreadPool( settings.addon.threads, settings.addon.threadAffinity ) );
+	ofLogVerbose( ofx_module() ) << "Using " << _pool->size() << " thread(s) for point cloud generation.";
+	_depthFilters.stages   = settings.addon.depthFilters;
+	_temporalFilter.params = settings.addon.temporalFilter;
+	_temporalFilter.reset();
+	depthImg.setUseTexture( settings.addon.useTextures );
+	depthMmImg.setUseTexture( settings.addon.useTextures );
+	if ( settings.addon.depthFormat == Settings::AddonSettings::DepthFormat::Millimeters16 ) {
+		depthImg.clear();  // only one of them is filled, see getDepthMmImage()
+	} else {
+		depthMmImg.clear();
+	}
+	irImg.setUseTexture( settings.addon.useTextures );
+	irRightImg.setUseTexture( settings.addon.useTextures );
+	irLeftImg.setUseTexture( settings.addon.useTextures );
+	visibleImg.setUseTexture( settings.addon.useTextures );
+	visibleLumaImg.setUseTexture( settings.addon.useTextures );
+	_depthStale = _irStale = _visibleRgbStale = _visibleLumaStale = false;
+	_irCameraStale[0] = _irCameraStale[1] = false;
+	for ( auto& conversion : _conversions ) {
+		conversion = Conversion();
+	}
+	resetLatency();
+	const float expectedFps[] = {settings.structureCore.depthFramerate, settings.structureCore.infraredFramerate, settings.structureCore.visibleFramerate};
+	for ( size_t i = 0; i < size_t( Stream::Count ); ++i ) {
+		_receivedRates[i].reset( expectedFps[i] );
+		_consumedRates[i].reset();
+	}
+	if ( _source->setup( settings ) ) {
 		_isInit = true;
 		ofLogNotice( ofx_module() ) << "Sensor " << ( serial().empty() ? "" : "[" + serial() + "]" ) << " session initialized.";
-		// HACK: if we have requested a serial number, the Structure SDK needs this thread to sleep for a bit before we can call startStreaming()
-		// very weird, but seems like the only fix right now
-		std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
 		return true;
 	} else {
 		ofLogError( ofx_module() ) << "Sensor session failed to initialize!";
@@ -40,13 +131,9 @@ bool ofxStructureCore::start( float timeout )
 		if ( timeout > 0. ) {
 
 			// block until ready signal received or we timeout
-			float start = ofGetElapsedTimef();
-			while ( !_isReady ) {
-				std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
-				if ( ofGetElapsedTimef() - start >= timeout ) {
-					ofLogError( ofx_module() ) << "Sensor [" << serial() << "] didn't start! Timed out after " << timeout << " seconds.";
-					return false;
-				}
+			if ( !waitUntilReady( timeout ) ) {
+				ofLogError( ofx_module() ) << "Sensor [" << serial() << "] didn't start! Timed out after " << timeout << " seconds.";
+				return false;
 			}
 		} else {
 			ofLogVerbose( ofx_module() ) << "Sensor [" << serial() << "] will start streaming when Ready signal is received (call stop() to cancel)...";
@@ -57,7 +144,7 @@ bool ofxStructureCore::start( float timeout )
 
 	if ( _isReady ) {
 
-		if ( _captureSession.startStreaming() ) {
+		if ( _source->startStreaming() ) {
 			ofLogVerbose( ofx_module() ) << "Requested sensor [" << serial() << "] start streaming.";
 			return true;
 
@@ -73,79 +160,369 @@ bool ofxStructureCore::start( float timeout )
 
 void ofxStructureCore::stop()
 {
-	_captureSession.stopStreaming();
+	_source->stopStreaming();
 	_isStreaming   = false;
 	_streamOnReady = false;
 }
 
+bool ofxStructureCore::waitUntilReady( float timeout )
+{
+	return waitForState( _isReady, timeout );
+}
+
+bool ofxStructureCore::waitUntilStreaming( float timeout )
+{
+	return waitForState( _isStreaming, timeout );
+}
+
+bool ofxStructureCore::waitForState( const std::atomic<bool>& state, float timeout )
+{
+	std::unique_lock<std::mutex> lck( _stateLock );
+	return _stateChanged.wait_for( lck, std::chrono::duration<float>( std::max( timeout, 0.f ) ), [&]() { return state.load(); } );
+}
+
+void ofxStructureCore::setState( std::atomic<bool>& state, bool value )
+{
+	{
+		std::lock_guard<std::mutex> lck( _stateLock );  // so a waiter can't miss it between its check and its wait
+		state = value;
+	}
+	_stateChanged.notify_all();
+}
+
 void ofxStructureCore::update()
+{
+	process();
+	upload();
+}
+
+void ofxStructureCore::process()
 {
 	if ( !_isStreaming ) {
 		return;
 	}
+	_deferUploads = true;  // images filled from here on are uploaded by upload()
+
+	_isFrameNew = false;
+	if ( _depthBuffer.consume() ) {
+		const auto& frame = _depthBuffer.front();
+		_depthIntrinsics  = frame.intrinsics;
+		_depthVisiblePose = frame.visiblePose;
+		_depthStale       = true;
+		frameConsumed( Stream::Depth );
+		_isFrameNew = true;
+	}
+	const bool isDepthNew = _isFrameNew;
+	if ( _irBuffer.consume() ) {
+		_irStale = _irCameraStale[0] = _irCameraStale[1] = true;
+		frameConsumed( Stream::Infrared );
+		_isFrameNew = true;
+	}
+	if ( _visibleBuffer.consume() ) {
+		const auto& frame  = _visibleBuffer.front();
+		_visibleRgbStale   = true;
+		_visibleLumaStale  = true;  // only filled if the frame turns out to be ycbcr
+		_visibleIntrinsics = frame.intrinsics;
+		frameConsumed( Stream::Visible );
+		_isFrameNew = true;
+	}
+
+	// fill the images now, unless the app reads them through the getters
+	// (the temporal filter and point cloud need every depth frame regardless)
+	const auto& addon = _settings.addon;
+	if ( !addon.lazyImages || addon.buildPointCloud || _temporalFilter.params.enabled ) {
+		updateDepthImage();
+	}
+	if ( !addon.lazyImages ) {
+		getInfraredImage();
+		if ( _visibleBuffer.front().resolve().chroma ) {
+			getVisibleLumaImage();  // rgb is still converted on demand
+		} else {
+			getVisibleRgb();
+		}
+	}
+
+	// update point cloud, after the visible frame was consumed so it can be colored with the latest one
+	if ( isDepthNew && addon.buildPointCloud ) {
+		computePointCloud();
+	}
+	_deferUploads = false;
+}
+
+void ofxStructureCore::upload()
+{
+	bool pending = _pointCloudUpload.pending;
+	for ( bool image : _uploadPending ) pending = pending || image;
+	if ( !pending ) {
+		return;
+	}
 
 	// wrap in ofEnableArbTex() to enforce rect tex coords internally
 	bool wasUsingArbTex = ofGetUsingArbTex();
 	ofEnableArbTex();
 
-	_isFrameNew = _depthDirty || _irDirty || _visibleDirty;
-	if ( _depthDirty ) {
-		{
-			float t = ofGetElapsedTimef();
-			if ( _lastDepthUpdateT == 0. ) {
-				_lastDepthUpdateT = t;
-				_depthUpdateFps   = 0.;
-			} else {
-				float diff        = t - _lastDepthUpdateT;
-				_depthUpdateFps   = 1. / diff;
-				_lastDepthUpdateT = t;
-				//ofLogNotice( ofx_module() ) << __FUNCTION__ << ": fps = " << ofToString( _depthUpdateFps, 1 ) << ", diff = " << ofToString( diff * 1000., 2 ) << "ms";
+	for ( size_t i = 0; i < size_t( Image::Count ); ++i ) {
+		if ( _uploadPending[i] ) {
+			_uploadPending[i] = false;
+			uploadImage( Image( i ) );
+		}
+	}
+	uploadPointCloud();  // after the depth texture, the gpu path reads it
+
+	// restore state
+	if ( !wasUsingArbTex ) {
+		ofDisableArbTex();
+	}
+}
+
+void ofxStructureCore::imageFilled( Image image )
+{
+	if ( _deferUploads ) {
+		_uploadPending[size_t( image )] = true;
+	} else {
+		uploadImage( image );
+	}
+}
+
+void ofxStructureCore::uploadImage( Image image )
+{
+	switch ( image ) {
+		case Image::Depth: updateImage( depthImg ); break;
+		case Image::DepthMm: updateImage( depthMmImg ); break;
+		case Image::Infrared: updateImage( irImg ); break;
+		case Image::InfraredRight: updateImage( irRightImg ); break;
+		case Image::InfraredLeft: updateImage( irLeftImg ); break;
+		case Image::Visible: updateImage( visibleImg ); break;
+		case Image::VisibleLuma: updateImage( visibleLumaImg ); break;
+		default: return;
+	}
+	static const Stream streams[] = {Stream::Depth, Stream::Depth, Stream::Infrared, Stream::Infrared, Stream::Infrared, Stream::Visible, Stream::Visible};  // by Image
+	frameConverted( streams[size_t( image )] );
+}
+
+// lazy images: each getter copies / converts the front() of its triple buffer (ours until the next consume())
+// and resolves its pixels first, so the source's conversions (depthInMillimeters() / rgbData()) run here too
+
+ofFloatImage& ofxStructureCore::getDepthImage()
+{
+	updateDepthImage();
+	return depthImg;
+}
+
+ofShortImage& ofxStructureCore::getDepthMmImage()
+{
+	updateDepthImage();
+	return depthMmImg;
+}
+
+void ofxStructureCore::updateDepthImage()
+{
+	if ( !_depthStale ) {
+		return;
+	}
+	using DepthFormat = Settings::AddonSettings::DepthFormat;
+	const auto& frame = _depthBuffer.front().resolve();
+	if ( _settings.addon.depthFormat == DepthFormat::Millimeters16 ) {
+		// filters run on a float copy, else the frame is rounded to mm straight from the sdk buffer
+		const float* depths = frame.data;
+		if ( !_depthFilters.stages.empty() || _temporalFilter.params.enabled || !frame.isPacked() ) {
+			_depthFiltered.resize( frame.size() );
+			ofx::structure::copyPixels( frame, _depthFiltered.data() );
+			if ( !_depthFilters.stages.empty() ) {
+				_depthFilters.apply( _depthFiltered.data(), frame.width, frame.height, *_pool );
 			}
+			_temporalFilter.apply( _depthFiltered.data(), frame.width, frame.height, *_pool );
+			depths = _depthFiltered.data();
+		} else {
+			_temporalFilter.apply( nullptr, frame.width, frame.height, *_pool );  // disabled, only forgets its history
+		}
+		auto& pixels = depthMmImg.getPixels();
+		if ( int( pixels.getWidth() ) != frame.width || int( pixels.getHeight() ) != frame.height || pixels.getNumChannels() != 1 ) {
+			pixels.allocate( frame.width, frame.height, 1 );
+		}
+		ofx::structure::depthToMillimeters( depths, pixels.getData(), frame.size(), *_pool );
+		imageFilled( Image::DepthMm );
+	} else {
+		toPixels( frame, depthImg.getPixels(), *_pool );  // the filters work in place, the frame stays untouched
+		if ( !_depthFilters.stages.empty() ) {
+			_depthFilters.apply( depthImg.getPixels().getData(), frame.width, frame.height, *_pool );
+		}
+		_temporalFilter.apply( depthImg.getPixels().getData(), frame.width, frame.height, *_pool );
+		imageFilled( Image::Depth );
+	}
+	_depthStale = false;
+}
 
-			std::unique_lock<std::mutex> lck( _frameLock );
-			depthImg.getPixels().setFromPixels( _depthFrame.depthInMillimeters(), _depthFrame.width(), _depthFrame.height(), 1 );
-			_depthIntrinsics = _depthFrame.intrinsics();
+ofShortImage& ofxStructureCore::getInfraredImage()
+{
+	if ( _irStale ) {
+		toPixels( _irBuffer.front().resolve(), irImg.getPixels(), *_pool );
+		imageFilled( Image::Infrared );
+		_irStale = false;
+	}
+	return irImg;
+}
+
+ofShortImage& ofxStructureCore::getInfraredImage( InfraredCamera camera )
+{
+	auto& img   = camera == InfraredCamera::Left ? irLeftImg : irRightImg;
+	bool& stale = _irCameraStale[size_t( camera )];
+	if ( stale ) {
+		const auto frame = getInfraredFrame( camera );
+		if ( frame.isValid() ) {
+			toPixels( frame, img.getPixels(), *_pool );  // half rows, straight out of the shared buffer
+			imageFilled( camera == InfraredCamera::Left ? Image::InfraredLeft : Image::InfraredRight );
 		}
-		depthImg.update();
-		// update point cloud
-		updatePointCloud();
-		_depthDirty = false;
+		stale = false;
 	}
-	if ( _irDirty ) {
-		{
-			std::unique_lock<std::mutex> lck( _frameLock );
-			irImg.getPixels().setFromPixels( _irFrame.data(), _irFrame.width(), _irFrame.height(), 1 );
+	return img;
+}
+
+ofx::structure::InfraredFrameHandle ofxStructureCore::getInfraredFrame( InfraredCamera camera ) const
+{
+	const auto frame = _irBuffer.front().resolved();
+	switch ( _settings.structureCore.infraredMode ) {
+		case Settings::IRMode::BothCameras: return ofx::structure::infraredCamera( frame, camera );
+		case Settings::IRMode::LeftCameraOnly: return camera == InfraredCamera::Left ? frame : ofx::structure::InfraredFrameHandle();
+		case Settings::IRMode::RightCameraOnly: return camera == InfraredCamera::Right ? frame : ofx::structure::InfraredFrameHandle();
+		default: return {};
+	}
+}
+
+ofImage& ofxStructureCore::getVisibleRgb()
+{
+	if ( _visibleRgbStale ) {
+		const auto& frame = _visibleBuffer.front().resolve();
+		if ( frame.chroma ) {
+			auto& pixels = visibleImg.getPixels();
+			if ( int( pixels.getWidth() ) != frame.width || int( pixels.getHeight() ) != frame.height || pixels.getNumChannels() != 3 ) {
+				pixels.allocate( frame.width, frame.height, 3 );
+			}
+			ofx::structure::yCbCrToRgb( frame.data, frame.chroma, frame.width, frame.height, pixels.getData(), *_pool );
+		} else {
+			toPixels( frame, visibleImg.getPixels(), *_pool );
 		}
-		irImg.update();
-		_irDirty = false;
+		imageFilled( Image::Visible );
+		_visibleRgbStale = false;
 	}
-	if ( _visibleDirty ) {
-		{
-			std::unique_lock<std::mutex> lck( _frameLock );
-			visibleImg.getPixels().setFromPixels( _visibleFrame.rgbData(), _visibleFrame.width(), _visibleFrame.height(), 3 );
+	return visibleImg;
+}
+
+ofImage& ofxStructureCore::getVisibleLumaImage()
+{
+	if ( _visibleLumaStale ) {
+		const auto& frame = _visibleBuffer.front().resolve();
+		if ( frame.chroma ) {
+			toPixels( frame, visibleLumaImg.getPixels(), *_pool );
+			imageFilled( Image::VisibleLuma );
 		}
-		visibleImg.update();
-		_visibleDirty = false;
+		_visibleLumaStale = false;
 	}
+	return visibleLumaImg;
+}
 
-	// restore state
-	if ( !wasUsingArbTex ) {
-		ofDisableArbTex();
+void ofxStructureCore::frameConsumed( Stream stream )
+{
+	auto& conversion = _conversions[size_t( stream )];
+	if ( conversion.unread ) {
+		++conversion.stats.skipped;  // replaced before anything read it
+	}
+	conversion.unread = true;
+	const double t    = _source->now();
+	_consumedRates[size_t( stream )].add( t );
+	withFrontFrame( stream, [&]( auto& frame ) {
+		frame.consumedTimestamp = t;
+		recordLatency( stream, LatencyStage::Consumed, frame, t );
+	} );
+}
+
+void ofxStructureCore::frameConverted( Stream stream )
+{
+	auto& conversion = _conversions[size_t( stream )];
+	if ( conversion.unread ) {
+		++conversion.stats.converted;  // once per frame, however many of its images are read
+		conversion.unread = false;
+		const double t    = _source->now();
+		withFrontFrame( stream, [&]( auto& frame ) {
+			frame.uploadedTimestamp = t;
+			recordLatency( stream, LatencyStage::Uploaded, frame, t );
+		} );
+	}
+}
+
+void ofxStructureCore::resetLatency()
+{
+	for ( auto& stages : _latency ) {
+		for ( auto& histogram : stages ) histogram.reset();
 	}
 }
 
-inline const glm::vec3 ofxStructureCore::getGyroRotationRate()
+const glm::vec3 ofxStructureCore::getGyroRotationRate() const
+{
+	ImuSample s;
+	_gyroQueue.latest( s );  // zero until the first sample
+	return {float( s.x ), float( s.y ), float( s.z )};
+}
+
+const glm::vec3 ofxStructureCore::getAcceleration() const
+{
+	ImuSample s;
+	_accelQueue.latest( s );
+	return {float( s.x ), float( s.y ), float( s.z )};
+}
+
+ofxStructureCore::ImuState ofxStructureCore::getImuAt( double timestamp, Stream coordinates ) const
+{
+	ImuState state;
+	ImuSample accel, gyro;
+	const bool hasAccel = _accelQueue.interpolate( timestamp, accel );
+	const bool hasGyro  = _gyroQueue.interpolate( timestamp, gyro );
+	const glm::mat3 r   = _imuToCamera.get( coordinates );
+	state.timestamp     = timestamp;
+	state.acceleration  = r * glm::vec3( accel.x, accel.y, accel.z );  // rotation only, no lever arm between imu and camera
+	state.rotationRate  = r * glm::vec3( gyro.x, gyro.y, gyro.z );
+	state.interpolated  = hasAccel && hasGyro;
+	return state;
+}
+
+void ofxStructureCore::updateImuExtrinsics()
+{
+	// camera from imu is the transposed rotation of "imu from camera" (column major, glm too)
+	auto toCamera = []( const ST::Matrix4& imuFromCamera ) {
+		glm::mat3 r;
+		for ( int col = 0; col < 3; ++col ) {
+			for ( int row = 0; row < 3; ++row ) r[col][row] = imuFromCamera.m[row * 4 + col];
+		}
+		return r;
+	};
+	const glm::mat3 depth = toCamera( _source->imuFromDepth() );
+	_imuToCamera.set( Stream::Depth, depth );
+	_imuToCamera.set( Stream::Infrared, depth );  // depth is computed in the infrared camera's frame
+	_imuToCamera.set( Stream::Visible, toCamera( _source->imuFromVisible() ) );
+}
+
+ofxStructureCore::FrameRateStats ofxStructureCore::getFrameRateStats( Stream stream ) const
 {
-	std::unique_lock<std::mutex> lck( _frameLock );
-	auto r = _gyroscopeEvent.rotationRate();
-	return {r.x, r.y, r.z};
+	const auto& received = _receivedRates[size_t( stream )];
+	FrameRateStats stats;
+	stats.fps         = received.fps();
+	stats.consumedFps = _consumedRates[size_t( stream )].fps();
+	stats.expectedFps = received.expectedFps();
+	stats.received    = received.count();
+	stats.gaps        = received.gaps();
+	stats.missed      = received.missed();
+	stats.dropped     = getFrameStats( stream ).dropped;
+	return stats;
 }
 
-inline const glm::vec3 ofxStructureCore::getAcceleration()
+ofxStructureCore::FrameStats ofxStructureCore::getFrameStats( Stream stream ) const
 {
-	std::unique_lock<std::mutex> lck( _frameLock );
-	auto a = _accelerometerEvent.acceleration();
-	return {a.x, a.y, a.z};
+	switch ( stream ) {
+		case Stream::Depth: return _depthBuffer.stats();
+		case Stream::Infrared: return _irBuffer.stats();
+		case Stream::Visible: return _visibleBuffer.stats();
+		default: return {};
+	}
 }
 
 // static methods
@@ -154,10 +531,11 @@ std::vector<std::string> ofxStructureCore::listDevices( bool bLog )
 {
 
 	std::vector<std::string> devices;
+	std::stringstream devices_ss;
+#ifndef OFX_STRUCTURE_CORE_NO_SDK
 	const ST::ConnectedSensorInfo* sensors[]{nullptr, nullptr, nullptr};
 	int count;
 	ST::enumerateConnectedSensors( sensors, &count );
-	std::stringstream devices_ss;
 	for ( int i = 0; i < count; ++i ) {
 		if ( sensors && sensors[i] ) {
 			if ( bLog ) {
@@ -171,6 +549,7 @@ std::vector<std::string> ofxStructureCore::listDevices( bool bLog )
 			devices.emplace_back( &( sensors[i]->serial[0] ) );
 		}
 	}
+#endif
 	if ( bLog ) {
 		ofLogNotice( ofx_module() ) << "\nFound " << devices.size() << " Structure Core devices: " << devices_ss.str();
 	}
@@ -179,73 +558,30 @@ std::vector<std::string> ofxStructureCore::listDevices( bool bLog )
 
 // protected callback handlers -- not to be called directly:
 
-inline void ofxStructureCore::handleNewFrame( const Frame& frame )
+// each frame's handle goes into the back slot of its triple buffer, then is published (never blocks on update())
+
+void ofxStructureCore::handleNewFrame( const ofx::structure::DepthFrameHandle& frame )
 {
-	if ( _lastFrameT == 0. ) {
-		_lastFrameT = ofGetElapsedTimef();
-		_fps        = 0.;
-	} else {
-		float t     = ofGetElapsedTimef();
-		float diff  = t - _lastFrameT;
-		_fps        = 1. / diff;
-		_lastFrameT = t;
-		//ofLogNotice( ofx_module() ) << __FUNCTION__ << ": fps = " << ofToString( _fps, 1 ) << ", diff = " << ofToString( diff * 1000., 2 ) << "ms";
-	}
-
-	switch ( frame.type ) {
-		case Frame::Type::DepthFrame: {
-			std::unique_lock<std::mutex> lck( _frameLock );
-			_depthFrame = frame.depthFrame;
-			_depthDirty = true;  // update the pix/tex in update() loop
-		} break;
-
-		case Frame::Type::VisibleFrame: {
-			std::unique_lock<std::mutex> lck( _frameLock );
-			_visibleFrame = frame.visibleFrame;
-			_visibleDirty = true;
-		} break;
-
-		case Frame::Type::InfraredFrame: {
-			std::unique_lock<std::mutex> lck( _frameLock );
-			_irFrame = frame.infraredFrame;
-			_irDirty = true;
-		} break;
-
-		case Frame::Type::SynchronizedFrames: {
-			if ( frame.depthFrame.isValid() ) {
-				std::unique_lock<std::mutex> lck( _frameLock );
-				_depthFrame = frame.depthFrame;
-				_depthDirty = true;
-			}
-			if ( frame.visibleFrame.isValid() ) {
-				std::unique_lock<std::mutex> lck( _frameLock );
-				_visibleFrame = frame.visibleFrame;
-				_visibleDirty = true;
-			}
-			if ( frame.infraredFrame.isValid() ) {
-				std::unique_lock<std::mutex> lck( _frameLock );
-				_irFrame = frame.infraredFrame;
-				_irDirty = true;
-			}
-		} break;
+	ingestFrame( Stream::Depth, frame, _depthBuffer, _depthHistory );  // update the pix/tex in update() loop
+}
 
-		case Frame::Type::AccelerometerEvent: {
-			std::unique_lock<std::mutex> lck( _frameLock );
-			_accelerometerEvent = frame.accelerometerEvent;
-		} break;
+void ofxStructureCore::handleNewFrame( const ofx::structure::InfraredFrameHandle& frame )
+{
+	ingestFrame( Stream::Infrared, frame, _irBuffer, _irHistory );
+}
 
-		case Frame::Type::GyroscopeEvent: {
-			std::unique_lock<std::mutex> lck( _frameLock );
-			_gyroscopeEvent = frame.gyroscopeEvent;
-		} break;
+void ofxStructureCore::handleNewFrame( const ofx::structure::VisibleFrameHandle& frame )
+{
+	ingestFrame( Stream::Visible, frame, _visibleBuffer, _visibleHistory );
+}
 
-		default: {
-			ofLogWarning( ofx_module() ) << "Unhandled frame type: " << Frame::toString( frame.type );
-		} break;
-	}
+void ofxStructureCore::handleNewSample( const ofx::structure::ImuSample& sample )
+{
+	getImuQueue( sample.type ).push( sample );  // wait-free, never contends with the frame path
+	_orientation.add( sample );
 }
 
-inline void ofxStructureCore::handleSessionEvent( EventType evt )
+void ofxStructureCore::handleSessionEvent( EventType evt )
 {
 	const std::string id = serial();
 	switch ( evt ) {
@@ -254,7 +590,8 @@ inline void ofxStructureCore::handleSessionEvent( EventType evt )
 			break;
 		case ST::CaptureSessionEventId::Ready:
 			ofLogNotice( ofx_module() ) << "Sensor " << id << " is ready.";
-			_isReady = true;
+			updateImuExtrinsics();  // before _isReady, so they're in place for whoever sees it set
+			setState( _isReady, true );
 			if ( _streamOnReady ) {
 				start( 0. );  // start streaming
 			}
@@ -264,37 +601,172 @@ inline void ofxStructureCore::handleSessionEvent( EventType evt )
 			break;
 		case ST::CaptureSessionEventId::Streaming:
 			ofLogVerbose( ofx_module() ) << "Sensor " << id << " is streaming.";
-			_isStreaming = true;
+			setState( _isStreaming, true );
 			break;
 		case ST::CaptureSessionEventId::Disconnected:
 			ofLogError( ofx_module() ) << "Sensor " << id << " - Disconnected!";
-			_isStreaming = false;
+			setState( _isStreaming, false );
 			break;
 		case ST::CaptureSessionEventId::Error:
 			ofLogError( ofx_module() ) << "Sensor " << id << " - Capture error!";
 			break;
 		default:
-			ofLogWarning( ofx_module() ) << "Sensor " << id << " - Unhandled capture session event type: " << Frame::toString( evt );
+			ofLogWarning( ofx_module() ) << "Sensor " << id << " - Unhandled capture session event type: " << ( int )evt;
 	}
 }
 
-void ofxStructureCore::updatePointCloud()
+void ofxStructureCore::computePointCloud()
 {
 
-	int cols = depthImg.getWidth();
-	int rows = depthImg.getHeight();
+	const auto& addon = _settings.addon;
+	const int stride  = std::max( 1, addon.pointStride );
+
+	using DepthFormat     = Settings::AddonSettings::DepthFormat;
+	using PointColors     = Settings::AddonSettings::PointColors;
+	const bool depthMm    = addon.depthFormat == DepthFormat::Millimeters16;
+	const int depthWidth  = int( depthMm ? depthMmImg.getPixels().getWidth() : depthImg.getPixels().getWidth() );  // the images' own dims are set by their upload
+	const int depthHeight = int( depthMm ? depthMmImg.getPixels().getHeight() : depthImg.getPixels().getHeight() );
 
-	float _fx = _depthIntrinsics.fx;
-	float _fy = _depthIntrinsics.fy;
-	float _cx = _depthIntrinsics.cx;
-	float _cy = _depthIntrinsics.cy;
+	int cols = ofx::structure::decimatedSize( depthWidth, stride );
+	int rows = ofx::structure::decimatedSize( depthHeight, stride );
 
 	size_t nVerts     = rows * cols;
 	pointcloud.width  = cols;
 	pointcloud.height = rows;
 
-	if ( ofIsGLProgrammableRenderer() ) {
+	// rebuilds only if dims / intrinsics changed
+	_depthRays.update( cols, rows, _depthIntrinsics, stride );
+
+	// compaction / downsampling are cpu only
+	const bool cpuOnly = addon.compactPointCloud || stride > 1 || addon.voxelSize > 0.f;
+
+	// what upload() hands to the vbo, clears are remembered until then
+	auto& upload   = _pointCloudUpload;
+	upload.pending = true;
+	upload.gpu     = ofIsGLProgrammableRenderer() && !cpuOnly;  // transform feedback from the depth texture
+	upload.normals = upload.colors = upload.texCoords = upload.mesh = false;
+
+	// millimeters: the plain cpu cloud unprojects the uint16_t grid directly, the other cpu stages get it widened to float (exact)
+	const bool gridStages = stride > 1 || addon.compactPointCloud || addon.computeNormals || addon.buildMesh || addon.pointColors != PointColors::Off;
+	const float* depths   = depthImg.getPixels().getData();
+	if ( depthMm ) {
+		depths = nullptr;
+		if ( gridStages ) {
+			_depthWidened.resize( depthMmImg.getPixels().size() );
+			ofx::structure::millimetersToDepth( depthMmImg.getPixels().getData(), _depthWidened.data(), _depthWidened.size(), *_pool );
+			depths = _depthWidened.data();
+		}
+	}
+	if ( stride > 1 ) {
+		_decimatedDepth.resize( nVerts );
+		ofx::structure::decimateDepth( depths, depthWidth, depthHeight, stride, _decimatedDepth.data(), *_pool );
+		depths = _decimatedDepth.data();
+	}
+
+	if ( !upload.gpu ) {
+
+		// build point cloud on cpu
+		auto& verts = pointcloud.points;
+		if ( addon.compactPointCloud ) {
+			// valid points only, counted first so the vectors are sized exactly
+			nVerts = _compactor.count( depths, _depthRays, *_pool );
+			verts.resize( nVerts );
+			pointcloud.indices.resize( nVerts );
+			_compactor.write( depths, _depthRays, verts.data(), pointcloud.indices.data(), *_pool );
+		} else {
+			verts.resize( nVerts );  // only allocates when the resolution changes
+			pointcloud.indices.clear();
+			if ( depths ) {
+				ofx::structure::depthToPoints( depths, _depthRays, verts.data(), *_pool );  // simd + row parallel, see ofxStructureCorePointCloud.cpp
+			} else {
+				ofx::structure::depthToPoints( depthMmImg.getPixels().getData(), _depthRays, verts.data(), *_pool );
+			}
+		}
+		if ( addon.voxelSize > 0.f ) {
+			// in place, the cloud is unorganized from here on
+			nVerts = _voxelGrid.filter( verts.data(), verts.size(), addon.voxelSize, verts.data(), *_pool );
+			verts.resize( nVerts );
+			pointcloud.indices.clear();
+		}
+	}
+
+	// normals from the organized depth grid (either path), voxel output has no grid
+	auto& normals = pointcloud.normals;
+	if ( addon.computeNormals && !( addon.voxelSize > 0.f ) ) {
+		if ( addon.compactPointCloud ) {
+			_gridNormals.resize( rows * cols );
+			ofx::structure::depthToNormals( depths, _depthRays, _gridNormals.data(), *_pool );
+			const auto& indices = pointcloud.indices;
+			normals.resize( indices.size() );
+			_pool->parallelFor( 0, indices.size(), 4096, [&]( size_t b, size_t e ) {
+				for ( size_t i = b; i < e; ++i ) normals[i] = _gridNormals[indices[i]];
+			} );
+		} else {
+			normals.resize( rows * cols );
+			ofx::structure::depthToNormals( depths, _depthRays, normals.data(), *_pool );  // simd + row parallel
+		}
+		upload.normals = true;
+	} else if ( !normals.empty() ) {
+		normals.clear();
+		upload.clearNormals = true;
+	}
+
+	// color from the visible camera, projected with its pose so it doesn't rely on the sdk's registration
+	auto& colors        = pointcloud.colors;
+	auto& texCoords     = pointcloud.texCoords;
+	const bool hasColor = addon.pointColors != PointColors::Off && getVisibleRgb().getPixels().isAllocated();
+	if ( hasColor ) {
+		_registration.update( _depthRays, _depthVisiblePose, _visibleIntrinsics );
+		auto& uvs = addon.pointColors == PointColors::TexCoords ? texCoords : _colorUvs;
+		uvs.resize( nVerts );
+		if ( addon.voxelSize > 0.f ) {
+			_registration.projectPoints( pointcloud.points.data(), nVerts, uvs.data(), *_pool );
+		} else if ( addon.compactPointCloud ) {
+			_registration.project( depths, pointcloud.indices.data(), nVerts, uvs.data(), *_pool );
+		} else {
+			_registration.project( depths, nullptr, nVerts, uvs.data(), *_pool );
+		}
+		if ( addon.pointColors == PointColors::Rgb ) {
+			colors.resize( nVerts );
+			ofx::structure::ColorRegistration::sample( uvs.data(), nVerts, visibleImg.getPixels().getData(), int( visibleImg.getPixels().getWidth() ), int( visibleImg.getPixels().getHeight() ), colors.data(), *_pool );
+			upload.colors = true;
+		} else {
+			upload.texCoords = true;
+		}
+	}
+	if ( !( hasColor && addon.pointColors == PointColors::Rgb ) && !colors.empty() ) {
+		colors.clear();
+		upload.clearColors = true;
+	}
+	if ( !( hasColor && addon.pointColors == PointColors::TexCoords ) && !texCoords.empty() ) {
+		texCoords.clear();
+		upload.clearTexCoords = true;
+	}
+
+	// triangles over the organized grid, indices only change where the depth did
+	auto& mesh = pointcloud.mesh;
+	if ( addon.buildMesh && !addon.compactPointCloud && !( addon.voxelSize > 0.f ) ) {
+		upload.mesh = mesh.update( depths, cols, rows, addon.meshMaxDepthJump, *_pool );
+	} else if ( !mesh.indices().empty() ) {
+		mesh.clear();
+		upload.clearMesh = true;
+	}
+}
+
+void ofxStructureCore::uploadPointCloud()
+{
+	auto& upload = _pointCloudUpload;
+	if ( !upload.pending ) {
+		return;
+	}
+	upload.pending = false;
+
+	const bool depthMm = _settings.addon.depthFormat == Settings::AddonSettings::DepthFormat::Millimeters16;
+	const int cols     = pointcloud.width;
+	const int rows     = pointcloud.height;
+	if ( upload.gpu ) {
 		// use tranfsorm feedback to calc point cloud on gpu
+		const size_t nVerts = size_t( rows ) * cols;
 
 		// load shader
 		if ( !_transformFbShader.isLoaded() ) {
@@ -329,13 +801,23 @@ void ofxStructureCore::updatePointCloud()
 			_transformFbBuffer.allocate( bufSz, GL_STREAM_READ );
 		}
 
+		// upload rays when the table was rebuilt
+		if ( _depthRayTexVersion != _depthRays.version() ) {
+			ofFloatPixels rays;
+			rays.allocate( std::max( cols, rows ), 2, 1 );
+			std::copy( _depthRays.x(), _depthRays.x() + cols, rays.getData() );
+			std::copy( _depthRays.y(), _depthRays.y() + rows, rays.getData() + rays.getWidth() );
+			_depthRayTex.loadData( rays );
+			_depthRayTexVersion = _depthRays.version();
+		}
+
 		// perform transform feedback
 		_transformFbShader.beginTransformFeedback( GL_POINTS, _transformFbBuffer );
 		{
-			_transformFbShader.setUniformTexture( "uDepthTex", depthImg.getTexture(), 1 );
+			_transformFbShader.setUniformTexture( "uDepthTex", depthMm ? depthMmImg.getTexture() : depthImg.getTexture(), 1 );
+			_transformFbShader.setUniform1f( "uDepthScale", depthMm ? 65535.f : 1.f );  // GL_R16 samples as 0 - 1
 			_transformFbShader.setUniform2i( "uDepthDims", cols, rows );
-			_transformFbShader.setUniform2f( "uC", _depthIntrinsics.cx, _depthIntrinsics.cy );
-			_transformFbShader.setUniform2f( "uF", _depthIntrinsics.fx, _depthIntrinsics.fy );
+			_transformFbShader.setUniformTexture( "uRayTex", _depthRayTex, 2 );
 			_transformFbVbo.draw( GL_POINTS, 0, _transformFbVbo.getNumVertices() );
 		}
 		_transformFbShader.endTransformFeedback( _transformFbBuffer );
@@ -345,23 +827,43 @@ void ofxStructureCore::updatePointCloud()
 
 		// todo: map memory to point cloud vertices on CPU?
 		// vbo.getVertexBuffer().map<glm::vec3>(GL_READ_ONLY);
-
 	} else {
+		pointcloud.vbo.setVertexData( pointcloud.points.data(), pointcloud.points.size(), GL_STREAM_DRAW );  // upload to GPU
+	}
 
-		// build point cloud on cpu
-		auto& depths = depthImg.getPixels();
-		std::vector<glm::vec3> verts( nVerts );
-		for ( int r = 0; r < rows; r++ ) {
-			for ( int c = 0; c < cols; c++ ) {
-				int i       = r * cols + c;
-				float depth = depths[i];  // millimeters
-				// project depth image into metric space
-				// see: http://nicolas.burrus.name/index.php/Research/KinectCalibration
-				verts[i].x = depth * ( c - _cx ) / _fx * -1.;  // invert x axis for opengl
-				verts[i].y = depth * ( r - _cy ) / _fy * -1.;  // invert y axis for opengl
-				verts[i].z = depth;
+	if ( upload.normals ) {
+		pointcloud.vbo.setNormalData( pointcloud.normals.data(), pointcloud.normals.size(), GL_STREAM_DRAW );
+	} else if ( upload.clearNormals ) {
+		pointcloud.vbo.clearNormals();
+	}
+	if ( upload.colors ) {
+		pointcloud.vbo.setColorData( pointcloud.colors.data(), pointcloud.colors.size(), GL_STREAM_DRAW );
+	} else if ( upload.clearColors ) {
+		pointcloud.vbo.clearColors();
+	}
+	if ( upload.texCoords ) {
+		pointcloud.vbo.setTexCoordData( pointcloud.texCoords.data(), pointcloud.texCoords.size(), GL_STREAM_DRAW );
+	} else if ( upload.clearTexCoords ) {
+		pointcloud.vbo.clearTexCoords();
+		_transformFbVbo.clear();  // gpu path: restores its static grid tex coords on the next frame
+	}
+	upload.clearNormals = upload.clearColors = upload.clearTexCoords = false;
+
+	// triangles over the organized grid, indices only change where the depth did
+	auto& mesh = pointcloud.mesh;
+	if ( upload.mesh ) {
+		const auto& indices = mesh.indices();
+		if ( mesh.resized() ) {
+			pointcloud.vbo.setIndexData( indices.data(), indices.size(), GL_DYNAMIC_DRAW );
+		} else {
+			// upload the changed cell rows only
+			const size_t perRow = mesh.indicesPerRow();
+			for ( const auto& run : mesh.dirtyRows() ) {
+				pointcloud.vbo.getIndexBuffer().updateData( run.first * perRow * sizeof( ofIndexType ), ( run.second - run.first ) * perRow * sizeof( ofIndexType ), &indices[run.first * perRow] );
 			}
 		}
-		pointcloud.vbo.setVertexData( verts.data(), nVerts, GL_STREAM_DRAW );  // upload to GPU
+	} else if ( upload.clearMesh ) {
+		pointcloud.vbo.clearIndices();
 	}
+	upload.clearMesh = false;
 }
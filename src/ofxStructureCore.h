@@ -1,113 +1,341 @@
+#pragma once
 #include "ST/CameraFrames.h"
 #include "ST/CaptureSession.h"
 #include "ST/IMUEvents.h"
 #include "ST/OCCFileWriter.h"
 #include "ST/Utilities.h"
 #include "ofMain.h"
+#include "ofxStructureCoreDepthFilter.h"
+#include "ofxStructureCoreDepthFormat.h"
+#include "ofxStructureCoreDownsample.h"
+#include "ofxStructureCoreFrameHistory.h"
+#include "ofxStructureCoreFrameRate.h"
+#include "ofxStructureCoreFrameSource.h"
+#include "ofxStructureCoreFrames.h"
+#include "ofxStructureCoreImuExtrinsics.h"
+#include "ofxStructureCoreImuQueue.h"
+#include "ofxStructureCoreLatency.h"
+#include "ofxStructureCoreMesh.h"
+#include "ofxStructureCoreOrientation.h"
+#include "ofxStructureCorePointCloud.h"
+#include "ofxStructureCoreRegistration.h"
+#include "ofxStructureCoreSensorSource.h"
 #include "ofxStructureCoreSettings.h"
+#include "ofxStructureCoreSyntheticSource.h"
+#include "ofxStructureCoreTemporalFilter.h"
+#include "ofxStructureCoreThreadPool.h"
+#include "ofxStructureCoreTripleBuffer.h"
 #include "ofxStructureCoreUtils.h"
 
-class ofxStructureCore : public ST::CaptureSessionDelegate
+class ofxStructureCore : public ofx::structure::FrameSource::Delegate
 {
 public:
-	using Settings = ofx::structure::Settings;
+	using Settings    = ofx::structure::Settings;
+	using FrameSource = ofx::structure::FrameSource;
+	using Stream          = ofx::structure::Stream;
+	using FrameStats      = ofx::structure::FrameStats;
+	using FrameRateStats  = ofx::structure::FrameRateStats;
+	using ConversionStats = ofx::structure::ConversionStats;
+	using TimeKey         = ofx::structure::TimeKey;
+	using InfraredCamera  = ofx::structure::InfraredCamera;
+	using ImuSample       = ofx::structure::ImuSample;
+	using ImuQueue        = ofx::structure::ImuQueue;
+	using ImuState        = ofx::structure::ImuState;
+	using Orientation     = ofx::structure::Orientation;
+	using LatencyStage    = ofx::structure::LatencyStage;
+	using LatencyStats    = ofx::structure::LatencyStats;
+
+	template <typename FrameType>
+	using FrameHistory = ofx::structure::FrameHistory<FrameType>;
 
 	ofxStructureCore();
+	~ofxStructureCore();
+
+	// replace the default sensor source (e.g. with ofx::structure::SyntheticFrameSource), call before setup()
+	void setFrameSource( std::unique_ptr<FrameSource> source );
+	FrameSource& getFrameSource() { return *_source; }
 
-	bool setup( const Settings& settings );  // call to init device
+	bool setup( const Settings& settings );  // call to init device (stops it first if it was set up before)
 	bool start( float timeout = 0.f );       // start streaming (if not already), wait timeout sec for response or if timeout == 0, start async
 	void stop();
-	void update();
+	void update();  // process() + upload()
+
+	// update() in two halves, e.g. to process several sensors side by side (see ofxStructureCoreGroup)
+	// process(): consume the new frames, fill the images and build the cpu point cloud -- any thread, one at a time
+	// upload(): the textures / point cloud vbo process() filled -- gl thread, after every process()
+	void process();
+	void upload();
 
 	const bool isFrameNew() const { return _isFrameNew; }
 	const bool isInit() const { return _isInit; }            // setup() was called
 	const bool isReady() const { return _isReady; }          // sensor is ready to start()
 	const bool isStreaming() const { return _isStreaming; }  // sensor has started
+
+	// block until the sensor signaled Ready / Streaming or timeout sec passed, true if it did (any thread, no polling)
+	bool waitUntilReady( float timeout );
+	bool waitUntilStreaming( float timeout );
 	const std::string serial() const
 	{
-		auto serial = std::string( &_captureSession.sensorInfo().serialNumber[0] );
+		auto serial = _source->serial();
 		if ( serial.empty() ) {
 			serial = _settings.getSerial();  // no sensor initialzed, fallback to settings
 		}
 		return serial;
 	}
 
-	const glm::vec3 getGyroRotationRate();
-	const glm::vec3 getAcceleration();
+	// latest imu samples (lock-free, any thread)
+	const glm::vec3 getGyroRotationRate() const;
+	const glm::vec3 getAcceleration() const;
+
+	// every sample of one imu sensor, sized by Settings::addon.imuQueueSize
+	// drain() from one consumer thread (e.g. once per update()), latest() / range() / around() from any thread
+	ImuQueue& getImuQueue( ImuSample::Type type ) { return type == ImuSample::Type::Accelerometer ? _accelQueue : _gyroQueue; }
+	const ImuQueue& getImuQueue( ImuSample::Type type ) const { return type == ImuSample::Type::Accelerometer ? _accelQueue : _gyroQueue; }
+
+	// imu readings at a frame's timestamp, interpolated between the queued samples of each sensor
+	// rotated into the stream's camera coordinates with the source's extrinsics (Depth / Infrared: depth camera, Visible: visible camera)
+	// lock-free from any thread, two binary searches per call, e.g. getImuAt( getDepthFrame() ) for every frame
+	ImuState getImuAt( double timestamp, Stream coordinates ) const;
+	ImuState getImuAt( const ofx::structure::DepthFrameView& frame ) const { return getImuAt( frame.timestamp, Stream::Depth ); }
+	ImuState getImuAt( const ofx::structure::InfraredFrameView& frame ) const { return getImuAt( frame.timestamp, Stream::Infrared ); }
+	ImuState getImuAt( const ofx::structure::VisibleFrameView& frame ) const { return getImuAt( frame.timestamp, Stream::Visible ); }
+
+	// latest orientation + gravity fused from every imu sample (Settings::addon.orientation), wait-free
+	// call from one thread (e.g. update() / draw()), resetOrientation() from anywhere
+	const Orientation& getOrientation() { return _orientation.get(); }
+	void resetOrientation() { _orientation.reset(); }
+
+	// workers used for point cloud generation, sized by Settings::addon.threads
+	// can be shared for app-side per-point work (call from the app thread)
+	ofx::structure::ThreadPool& getThreadPool() { return *_pool; }
+
+	// depth filters from Settings::addon.depthFilters, stages can be edited / toggled between update() calls
+	ofx::structure::DepthFilterChain& getDepthFilterChain() { return _depthFilters; }
+
+	// temporal filter from Settings::addon.temporalFilter, params can be edited / toggled between update() calls
+	ofx::structure::TemporalFilter& getTemporalFilter() { return _temporalFilter; }
+
+	// frame handoff counters (published by sensor thread / consumed by update() / dropped before update())
+	FrameStats getFrameStats( Stream stream ) const;
+
+	// received / consumed rates over the last second, gaps in the sensor timestamps vs the configured framerate, and drops (any thread)
+	FrameRateStats getFrameRateStats( Stream stream ) const;
+
+	// capture -> stage latency of the stream's frames (p50 / p95 / p99 / max in ms), lock-free, query from any thread
+	// each frame also carries its own stage timestamps, see FrameView::*Timestamp
+	LatencyStats getLatency( Stream stream, LatencyStage stage ) const { return _latency[size_t( stream )][size_t( stage )].stats(); }
+	void resetLatency();
+
+	// consumed frames converted into / skipped by the stream's image(s), see Settings::addon.lazyImages
+	ConversionStats getConversionStats( Stream stream ) const { return _conversions[size_t( stream )].stats; }
+
+	// timestamped frame history, sized by Settings::addon.*HistorySize
+	// safe to query from any thread, e.g. getVisibleHistory().nearest( depthT, frame )
+	// holds handles, so queries don't copy pixels (and each entry keeps its frame buffer alive)
+	// resolve() a frame from the history before reading its data / chroma
+	const FrameHistory<ofx::structure::DepthFrameHandle>& getDepthHistory() const { return _depthHistory; }
+	const FrameHistory<ofx::structure::InfraredFrameHandle>& getInfraredHistory() const { return _irHistory; }
+	const FrameHistory<ofx::structure::VisibleFrameHandle>& getVisibleHistory() const { return _visibleHistory; }
+
+	// latest frames consumed by update(), as delivered by the source (unfiltered, no copy), resolved
+	// read the pixels in place, or keep the handle as long as needed -- the buffer stays valid while it's held
+	ofx::structure::DepthFrameHandle getDepthFrame() const { return _depthBuffer.front().resolved(); }
+	ofx::structure::InfraredFrameHandle getInfraredFrame() const { return _irBuffer.front().resolved(); }
+	ofx::structure::VisibleFrameHandle getVisibleFrame() const { return _visibleBuffer.front().resolved(); }
+
+	// one camera of the latest infrared frame, a strided view into the same buffer (IRMode::BothCameras)
+	// LeftCameraOnly / RightCameraOnly: the whole frame for that camera, an invalid handle for the other
+	ofx::structure::InfraredFrameHandle getInfraredFrame( InfraredCamera camera ) const;
 
 	// static methods
 	static std::vector<std::string> listDevices( bool bLog );
 	static void setLogLevel( ofLogLevel lvl ) { ofSetLogLevel( ofx_module(), lvl ); }
 
-	ofFloatImage depthImg;  // float data is in mm (0 - 65355)
-	ofShortImage irImg;
-	ofImage visibleImg;
+	// filled by update(), or with Settings::addon.lazyImages only when read through the getters below
+	ofFloatImage depthImg;    // float data is in mm (0 - 65355)
+	ofShortImage depthMmImg;  // depthFormat Millimeters16 instead of depthImg: uint16_t mm, 0 = invalid
+	ofShortImage irImg;       // IRMode::BothCameras: both cameras side by side, see getInfraredImage( camera )
+	ofShortImage irRightImg;  // only filled by getInfraredImage( InfraredCamera::Right )
+	ofShortImage irLeftImg;   // only filled by getInfraredImage( InfraredCamera::Left )
+	ofImage visibleImg;       // visibleYCbCr: only filled by getVisibleRgb()
+	ofImage visibleLumaImg;   // visibleYCbCr: luma plane of the visible frame
+
+	// the images for the latest frames, copied / converted + uploaded at most once per frame (call from the update() thread)
+	ofFloatImage& getDepthImage();    // filtered, see getDepthFilterChain() / getTemporalFilter()
+	ofShortImage& getDepthMmImage();  // depthFormat Millimeters16: the same, rounded to mm (simd)
+	ofShortImage& getInfraredImage();
+	ofImage& getVisibleRgb();         // visibleYCbCr: converts the planes to rgb (simd)
+	ofImage& getVisibleLumaImage();   // visibleYCbCr only
+
+	// one camera of the infrared frame into irRightImg / irLeftImg, copies only the camera asked for (row blocks on the pool)
+	ofShortImage& getInfraredImage( InfraredCamera camera );
 
 	struct PointCloud
 	{
 		ofVbo vbo;
-		int width, height;
+		int width, height;                 // grid the points came from (depth dims / pointStride)
+		std::vector<glm::vec3> points;     // cpu copy of the vertices (cpu path only)
+		std::vector<uint32_t> indices;     // compact mode: grid index (r * width + c) of each point, else empty
+		std::vector<glm::vec3> normals;    // computeNormals: one per point, unit length facing the sensor, (0,0,0) where undefined
+		std::vector<ofFloatColor> colors;  // pointColors Rgb: one per point from visibleImg, alpha 0 where the visible camera didn't see it
+		std::vector<glm::vec2> texCoords;  // pointColors TexCoords: visibleImg pixel per point, (-1,-1) where the visible camera didn't see it
+		ofx::structure::GridMesher mesh;   // buildMesh: index buffer over the grid, see mesh.indices()
 		void draw()
 		{
 			vbo.draw( GL_POINTS, 0, vbo.getNumVertices() );
 		}
+		void drawMesh()
+		{
+			vbo.drawElements( GL_TRIANGLES, vbo.getNumIndices() );
+		}
 	} pointcloud;
 
 protected:
-	ST::CaptureSession _captureSession;
+	std::unique_ptr<FrameSource> _source;
 	Settings _settings;
+	std::unique_ptr<ofx::structure::ThreadPool> _pool;
 
-	std::mutex _frameLock;  // delegate receives frames on background thread
+	// latest frames, handed from the SDK thread to update() without locking or copying
+	ofx::structure::TripleBuffer<ofx::structure::DepthFrameHandle> _depthBuffer;
+	ofx::structure::TripleBuffer<ofx::structure::InfraredFrameHandle> _irBuffer;
+	ofx::structure::TripleBuffer<ofx::structure::VisibleFrameHandle> _visibleBuffer;
 
-	float _lastFrameT, _fps, _lastDepthUpdateT, _depthUpdateFps;
+	// every received frame, for timestamp queries
+	FrameHistory<ofx::structure::DepthFrameHandle> _depthHistory;
+	FrameHistory<ofx::structure::InfraredFrameHandle> _irHistory;
+	FrameHistory<ofx::structure::VisibleFrameHandle> _visibleHistory;
 
-	// latest frames / events
-	ST::DepthFrame _depthFrame;
-	ST::InfraredFrame _irFrame;
-	ST::ColorFrame _visibleFrame;
-	ST::GyroscopeEvent _gyroscopeEvent;
-	ST::AccelerometerEvent _accelerometerEvent;
+	// every imu sample, pushed by the source's imu thread without locking
+	ImuQueue _accelQueue;
+	ImuQueue _gyroQueue;
+	ofx::structure::OrientationFilter _orientation;  // fused on the imu thread
+	ofx::structure::ImuExtrinsics _imuToCamera;  // imu -> each stream's camera coordinates, set on Ready
+	void updateImuExtrinsics();
 
 	std::atomic<bool>
-	    _isInit,               // called setup()
-	    _isReady,              // got ready signal from SDK
-	    _isStreaming = false;  // got streaming signal from SDK
-
-	bool _streamOnReady,  // should call start() on ready signal from SDK
-	    _isFrameNew,
-	    _depthDirty,
-	    _irDirty,
-	    _visibleDirty = false;
-	ST::Intrinsics _depthIntrinsics;
+	    _isInit{false},       // called setup()
+	    _isReady{false},      // got ready signal from SDK
+	    _isStreaming{false};  // got streaming signal from SDK
+
+	// session state changes, for waitUntil*()
+	std::mutex _stateLock;
+	std::condition_variable _stateChanged;
+	void setState( std::atomic<bool>& state, bool value );
+	bool waitForState( const std::atomic<bool>& state, float timeout );
+
+	bool _streamOnReady = false,  // should call start() on ready signal from SDK
+	    _isFrameNew     = false;
+	ST::Intrinsics _depthIntrinsics, _visibleIntrinsics;
+	ST::Matrix4 _depthVisiblePose;  // of the last depth frame
+	// images behind the front() of their triple buffer
+	bool _depthStale = false, _irStale = false, _visibleRgbStale = false, _visibleLumaStale = false;
+	bool _irCameraStale[2] = {false, false};  // by InfraredCamera
+
+	struct Conversion
+	{
+		bool unread = false;  // the consumed frame hasn't been turned into an image yet
+		ConversionStats stats;
+	} _conversions[size_t( Stream::Count )];
+	void frameConsumed( Stream stream );
+	void frameConverted( Stream stream );
+
+	// images filled inside process() are uploaded by upload(), outside it (the lazy getters) right away
+	enum class Image
+	{
+		Depth,
+		DepthMm,
+		Infrared,
+		InfraredRight,
+		InfraredLeft,
+		Visible,
+		VisibleLuma,
+		Count
+	};
+	bool _deferUploads                          = false;
+	bool _uploadPending[size_t( Image::Count )] = {};
+	void imageFilled( Image image );
+	void uploadImage( Image image );
+
+	// per stream: sensor timestamps as they're received (source thread), consume times (app thread)
+	ofx::structure::FrameRateEstimator _receivedRates[size_t( Stream::Count )];
+	ofx::structure::FrameRateEstimator _consumedRates[size_t( Stream::Count )];
+
+	// capture -> stage, by stream and LatencyStage
+	ofx::structure::LatencyHistogram _latency[size_t( Stream::Count )][size_t( LatencyStage::Count )];
+	template <typename PixelType>
+	void recordLatency( Stream stream, LatencyStage stage, const ofx::structure::FrameView<PixelType>& frame, double t )
+	{
+		if ( frame.timestamp > 0. && t > 0. ) _latency[size_t( stream )][size_t( stage )].record( t - frame.timestamp );
+	}
+	template <typename Fn>
+	void withFrontFrame( Stream stream, Fn fn )  // fn( front() of the stream's triple buffer )
+	{
+		switch ( stream ) {
+			case Stream::Depth: fn( _depthBuffer.front() ); break;
+			case Stream::Infrared: fn( _irBuffer.front() ); break;
+			case Stream::Visible: fn( _visibleBuffer.front() ); break;
+			default: break;
+		}
+	}
+	ofx::structure::RayTable _depthRays;  // cached unprojection rays for _depthIntrinsics
+	ofTexture _depthRayTex;               // _depthRays for the transform feedback shader
+	uint64_t _depthRayTexVersion = 0;
 	ofShader _transformFbShader;        // converts depth image to point cloud
 	ofBufferObject _transformFbBuffer;  // gpu buffer for point cloud
 	ofVbo _transformFbVbo;              // static vbo for transform fb
 
-	using Frame = ST::CaptureSessionSample;
-	void handleNewFrame( const Frame& frame );
+	ofx::structure::DepthFilterChain _depthFilters;
+	ofx::structure::TemporalFilter _temporalFilter;
+	std::vector<float> _depthFiltered;  // depthFormat Millimeters16: filter input, before rounding to mm
+	std::vector<float> _depthWidened;   // depthFormat Millimeters16: depthMmImg as float for the cpu stages that need it
+	void updateDepthImage();            // fills depthImg / depthMmImg if stale
 
-	using EventType = ST::CaptureSessionEventId;
-	void handleSessionEvent( EventType evt );
+	// cpu point cloud stages, see Settings::addon
+	ofx::structure::PointCompactor _compactor;
+	ofx::structure::VoxelGrid _voxelGrid;
+	std::vector<float> _decimatedDepth;               // pointStride > 1
+	std::vector<glm::vec3> _gridNormals;              // computeNormals + compactPointCloud
+	ofx::structure::ColorRegistration _registration;  // pointColors
+	std::vector<glm::vec2> _colorUvs;                 // pointColors Rgb
 
-	void updatePointCloud();
+	// frame source delegate, called on the source's background thread(s)
+	void handleNewFrame( const ofx::structure::DepthFrameHandle& frame ) override;
+	void handleNewFrame( const ofx::structure::InfraredFrameHandle& frame ) override;
+	void handleNewFrame( const ofx::structure::VisibleFrameHandle& frame ) override;
+	void handleNewSample( const ofx::structure::ImuSample& sample ) override;
 
-	static inline const std::string& ofx_module()
+	using EventType = FrameSource::EventType;
+	void handleSessionEvent( EventType evt ) override;
+
+	// share a frame with the stream's triple buffer + history and publish it (ref counts only, no pixel copy)
+	template <typename PixelType>
+	void ingestFrame( Stream stream, const ofx::structure::FrameHandle<PixelType>& src, ofx::structure::TripleBuffer<ofx::structure::FrameHandle<PixelType>>& buffer, FrameHistory<ofx::structure::FrameHandle<PixelType>>& history )
 	{
-		static const std::string name = "ofxStructureCore";
-		return name;
+		const double t          = _source->now();
+		auto& frame             = buffer.back();
+		frame                   = src;
+		frame.callbackTimestamp = t;
+		history.push( frame );
+		buffer.publish();  // back() belongs to the consumer from here on
+		_receivedRates[size_t( stream )].add( src.timestamp );
+		recordLatency( stream, LatencyStage::Arrival, src, src.arrivalTimestamp );
+		recordLatency( stream, LatencyStage::Callback, src, t );
 	}
 
-public:
-	// delegate functions overrides
-	void captureSessionEventDidOccur( ST::CaptureSession* session, ST::CaptureSessionEventId evt ) override
+	// the cpu part of the point cloud in process(), the vbo / transform feedback in upload()
+	struct PointCloudUpload
 	{
-		if ( session == &_captureSession )
-			handleSessionEvent( evt );
-		else
-			ofLogError( ofx_module() ) << "Received capture session event for unknown capture session: " << ( int )session;
-	}
-	void captureSessionDidOutputSample( ST::CaptureSession*, const ST::CaptureSessionSample& sample ) override
+		bool pending      = false;
+		bool gpu          = false;  // transform feedback from the depth texture, else points were built on the cpu
+		bool normals      = false, colors = false, texCoords = false, mesh = false;
+		bool clearNormals = false, clearColors = false, clearTexCoords = false, clearMesh = false;  // kept until uploaded
+	} _pointCloudUpload;
+	void computePointCloud();
+	void uploadPointCloud();
+
+	static inline const std::string& ofx_module()
 	{
-		handleNewFrame( sample );
+		static const std::string name = "ofxStructureCore";
+		return name;
 	}
 };
@@ -0,0 +1,318 @@
+#include "ofxStructureCoreDepthFilter.h"
+#include "ofMain.h"
+#include "ofxStructureCoreSimd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	std::string to_string( DepthFilterStage::Type type )
+	{
+		switch ( type ) {
+			case DepthFilterStage::Median3: return "Median3";
+			case DepthFilterStage::Median5: return "Median5";
+			case DepthFilterStage::Bilateral: return "Bilateral";
+			default: return "Unknown";
+		}
+	}
+
+	namespace {
+
+		// -----------------------------------------------------------------------
+		// median: compare-exchange network, same min / max sequence for scalar and vector lanes
+		// * batcher odd-even merge sort for n inputs, pruned to the exchanges the middle output depends on
+		// * invalid neighbours are replaced by the center, so they neither win nor shift the median
+		// -----------------------------------------------------------------------
+
+		struct MedianNetwork
+		{
+			int n;
+			std::vector<std::pair<uint8_t, uint8_t>> pairs;
+
+			explicit MedianNetwork( int size )
+			    : n( size )
+			{
+				std::vector<std::pair<uint8_t, uint8_t>> all;
+				for ( int p = 1; p < n; p <<= 1 ) {
+					for ( int k = p; k >= 1; k >>= 1 ) {
+						for ( int j = k % p; j + k < n; j += 2 * k ) {
+							for ( int i = 0; i < std::min( k, n - j - k ); ++i ) {
+								if ( ( i + j ) / ( 2 * p ) == ( i + j + k ) / ( 2 * p ) ) all.emplace_back( i + j, i + j + k );
+							}
+						}
+					}
+				}
+				// walk back from the middle output, keeping exchanges that feed it
+				std::vector<bool> needed( n, false );
+				needed[n / 2] = true;
+				for ( auto it = all.rbegin(); it != all.rend(); ++it ) {
+					if ( needed[it->first] || needed[it->second] ) {
+						needed[it->first] = needed[it->second] = true;
+						pairs.push_back( *it );
+					}
+				}
+				std::reverse( pairs.begin(), pairs.end() );
+			}
+		};
+
+		const MedianNetwork& medianNetwork( int radius )
+		{
+			static const MedianNetwork net3( 9 ), net5( 25 );
+			return radius == 1 ? net3 : net5;
+		}
+
+		inline int clampTo( int v, int lo, int hi ) { return v < lo ? lo : ( v > hi ? hi : v ); }
+
+		float medianAt( const float* src, int width, int height, int r, int c, int radius )
+		{
+			const float center = src[size_t( r ) * width + c];
+			if ( !( center > 0.f ) ) return 0.f;
+			const MedianNetwork& net = medianNetwork( radius );
+			float v[25];
+			int k = 0;
+			for ( int dy = -radius; dy <= radius; ++dy ) {
+				const float* row = src + size_t( clampTo( r + dy, 0, height - 1 ) ) * width;
+				for ( int dx = -radius; dx <= radius; ++dx ) {
+					float d = row[clampTo( c + dx, 0, width - 1 )];
+					v[k++]  = d > 0.f ? d : center;
+				}
+			}
+			for ( const auto& p : net.pairs ) {
+				float a = v[p.first], b = v[p.second];
+				v[p.first]  = a < b ? a : b;  // same as _mm_min_ps / _mm_max_ps
+				v[p.second] = a > b ? a : b;
+			}
+			return v[net.n / 2];
+		}
+
+		// -----------------------------------------------------------------------
+		// bilateral: w = spatial( dx, dy ) * exp( -dz^2 / 2 sigmaDepth^2 ), invalid neighbours get w = 0
+		// * exp is a polynomial approximation, written the same way for scalar and vector lanes
+		// -----------------------------------------------------------------------
+
+		struct BilateralWeights
+		{
+			int radius;
+			float negInvTwoSigmaDepth2;
+			float spatial[121];  // radius <= 5
+
+			explicit BilateralWeights( const DepthFilterStage& stage )
+			{
+				radius                 = clampTo( stage.radius, 1, 5 );
+				const float sigmaSpace = std::max( stage.sigmaSpace, 1e-3f );
+				const float sigmaDepth = std::max( stage.sigmaDepth, 1e-3f );
+				negInvTwoSigmaDepth2   = -1.f / ( 2.f * sigmaDepth * sigmaDepth );
+				int k                  = 0;
+				for ( int dy = -radius; dy <= radius; ++dy ) {
+					for ( int dx = -radius; dx <= radius; ++dx ) {
+						spatial[k++] = std::exp( -float( dx * dx + dy * dy ) / ( 2.f * sigmaSpace * sigmaSpace ) );
+					}
+				}
+			}
+		};
+
+		// exp( x ) for x <= 0, ~1e-4 relative error
+		// clamped at exp( -24 ) ~ 4e-11: far below the center's weight of 1, and keeps the weights away from slow denormals
+		inline float expNeg( float x )
+		{
+			x        = x > -24.f ? x : -24.f;
+			float t  = x * 1.44269504f;  // log2( e )
+			int i    = int( t );         // truncates toward 0
+			float fi = float( i );
+			if ( fi > t ) {
+				fi -= 1.f;
+				i -= 1;
+			}
+			const float f = t - fi;
+			const float p = 1.f + f * ( 0.693147181f + f * ( 0.240226507f + f * ( 0.0555041087f + f * ( 0.00961812911f + f * 0.00133335581f ) ) ) );
+			uint32_t bits = uint32_t( i + 127 ) << 23;
+			float scale;
+			std::memcpy( &scale, &bits, sizeof( scale ) );
+			return p * scale;
+		}
+
+		float bilateralAt( const float* src, int width, int height, int r, int c, const BilateralWeights& weights )
+		{
+			const float center = src[size_t( r ) * width + c];
+			if ( !( center > 0.f ) ) return 0.f;
+			const int radius = weights.radius;
+			float sumW = 0.f, sumWZ = 0.f;
+			int k      = 0;
+			for ( int dy = -radius; dy <= radius; ++dy ) {
+				const float* row = src + size_t( clampTo( r + dy, 0, height - 1 ) ) * width;
+				for ( int dx = -radius; dx <= radius; ++dx, ++k ) {
+					const float d     = row[clampTo( c + dx, 0, width - 1 )];
+					const bool valid  = d > 0.f;
+					const float diff  = d - center;
+					const float w     = weights.spatial[k] * expNeg( diff * diff * weights.negInvTwoSigmaDepth2 );
+					const float wMask = valid ? w : 0.f;
+					sumW += wMask;
+					sumWZ += wMask * ( valid ? d : 0.f );
+				}
+			}
+			return sumWZ / sumW;  // the center's weight is 1, so sumW >= 1
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		inline __m128 select( __m128 mask, __m128 a, __m128 b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+
+		inline __m128 expNeg4( __m128 x )
+		{
+			x              = _mm_max_ps( x, _mm_set1_ps( -24.f ) );
+			__m128 t       = _mm_mul_ps( x, _mm_set1_ps( 1.44269504f ) );
+			__m128i i      = _mm_cvttps_epi32( t );
+			__m128 fi      = _mm_cvtepi32_ps( i );
+			__m128 below   = _mm_cmpgt_ps( fi, t );  // truncated up, step down one
+			fi             = _mm_sub_ps( fi, _mm_and_ps( below, _mm_set1_ps( 1.f ) ) );
+			i              = _mm_add_epi32( i, _mm_castps_si128( below ) );  // mask is -1
+			const __m128 f = _mm_sub_ps( t, fi );
+			__m128 p       = _mm_mul_ps( f, _mm_set1_ps( 0.00133335581f ) );
+			p              = _mm_mul_ps( f, _mm_add_ps( _mm_set1_ps( 0.00961812911f ), p ) );
+			p              = _mm_mul_ps( f, _mm_add_ps( _mm_set1_ps( 0.0555041087f ), p ) );
+			p              = _mm_mul_ps( f, _mm_add_ps( _mm_set1_ps( 0.240226507f ), p ) );
+			p              = _mm_mul_ps( f, _mm_add_ps( _mm_set1_ps( 0.693147181f ), p ) );
+			p              = _mm_add_ps( _mm_set1_ps( 1.f ), p );
+			const __m128 scale = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( i, _mm_set1_epi32( 127 ) ), 23 ) );
+			return _mm_mul_ps( p, scale );
+		}
+
+		// interior: 4 pixels per step, border rows / columns go through the scalar per pixel path
+		void medianRowsSSE2( const float* src, float* dst, int width, int height, int rowBegin, int rowEnd, int radius )
+		{
+			const MedianNetwork& net = medianNetwork( radius );
+			const __m128 zero        = _mm_setzero_ps();
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				float* out = dst + size_t( r ) * width;
+				int c      = 0;
+				if ( r >= radius && r + radius < height ) {
+					for ( ; c < radius; ++c ) out[c] = medianAt( src, width, height, r, c, radius );
+					for ( ; c + 4 + radius <= width; c += 4 ) {
+						const __m128 center = _mm_loadu_ps( src + size_t( r ) * width + c );
+						__m128 v[25];
+						int k = 0;
+						for ( int dy = -radius; dy <= radius; ++dy ) {
+							const float* row = src + size_t( r + dy ) * width + c;
+							for ( int dx = -radius; dx <= radius; ++dx ) {
+								const __m128 d = _mm_loadu_ps( row + dx );
+								v[k++]         = select( _mm_cmpgt_ps( d, zero ), d, center );
+							}
+						}
+						for ( const auto& p : net.pairs ) {
+							const __m128 a = v[p.first], b = v[p.second];
+							v[p.first]     = _mm_min_ps( a, b );
+							v[p.second]    = _mm_max_ps( a, b );
+						}
+						_mm_storeu_ps( out + c, _mm_and_ps( v[net.n / 2], _mm_cmpgt_ps( center, zero ) ) );
+					}
+				}
+				for ( ; c < width; ++c ) out[c] = medianAt( src, width, height, r, c, radius );
+			}
+		}
+
+		void bilateralRowsSSE2( const float* src, float* dst, int width, int height, int rowBegin, int rowEnd, const BilateralWeights& weights )
+		{
+			const int radius  = weights.radius;
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 negK = _mm_set1_ps( weights.negInvTwoSigmaDepth2 );
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				float* out = dst + size_t( r ) * width;
+				int c      = 0;
+				if ( r >= radius && r + radius < height ) {
+					for ( ; c < radius; ++c ) out[c] = bilateralAt( src, width, height, r, c, weights );
+					for ( ; c + 4 + radius <= width; c += 4 ) {
+						const __m128 center = _mm_loadu_ps( src + size_t( r ) * width + c );
+						__m128 sumW = zero, sumWZ = zero;
+						int k = 0;
+						for ( int dy = -radius; dy <= radius; ++dy ) {
+							const float* row = src + size_t( r + dy ) * width + c;
+							for ( int dx = -radius; dx <= radius; ++dx, ++k ) {
+								const __m128 d     = _mm_loadu_ps( row + dx );
+								const __m128 valid = _mm_cmpgt_ps( d, zero );
+								const __m128 diff  = _mm_sub_ps( d, center );
+								const __m128 w     = _mm_mul_ps( _mm_set1_ps( weights.spatial[k] ), expNeg4( _mm_mul_ps( _mm_mul_ps( diff, diff ), negK ) ) );
+								const __m128 wMask = _mm_and_ps( valid, w );
+								sumW               = _mm_add_ps( sumW, wMask );
+								sumWZ              = _mm_add_ps( sumWZ, _mm_mul_ps( wMask, _mm_and_ps( valid, d ) ) );
+							}
+						}
+						// invalid center: 0 (and no 0 / 0)
+						const __m128 ok = _mm_cmpgt_ps( center, zero );
+						_mm_storeu_ps( out + c, _mm_and_ps( ok, _mm_div_ps( sumWZ, select( ok, sumW, _mm_set1_ps( 1.f ) ) ) ) );
+					}
+				}
+				for ( ; c < width; ++c ) out[c] = bilateralAt( src, width, height, r, c, weights );
+			}
+		}
+#endif
+
+	}  // namespace
+
+	void applyDepthFilterScalar( const DepthFilterStage& stage, const float* src, float* dst, int width, int height, int rowBegin, int rowEnd )
+	{
+		if ( stage.type == DepthFilterStage::Bilateral ) {
+			const BilateralWeights weights( stage );
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				for ( int c = 0; c < width; ++c ) dst[size_t( r ) * width + c] = bilateralAt( src, width, height, r, c, weights );
+			}
+		} else {
+			const int radius = stage.type == DepthFilterStage::Median3 ? 1 : 2;
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				for ( int c = 0; c < width; ++c ) dst[size_t( r ) * width + c] = medianAt( src, width, height, r, c, radius );
+			}
+		}
+	}
+
+	void applyDepthFilter( const DepthFilterStage& stage, const float* src, float* dst, int width, int height, int rowBegin, int rowEnd )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2:
+				if ( stage.type == DepthFilterStage::Bilateral ) {
+					bilateralRowsSSE2( src, dst, width, height, rowBegin, rowEnd, BilateralWeights( stage ) );
+				} else {
+					medianRowsSSE2( src, dst, width, height, rowBegin, rowEnd, stage.type == DepthFilterStage::Median3 ? 1 : 2 );
+				}
+				return;
+#endif
+			default: applyDepthFilterScalar( stage, src, dst, width, height, rowBegin, rowEnd ); return;
+		}
+	}
+
+	// -----------------------------------------------------------------------
+
+	void DepthFilterChain::apply( float* depths, int width, int height, ThreadPool& pool )
+	{
+		_stageMicros.assign( stages.size(), 0 );
+		_totalMicros = 0;
+
+		const size_t n = size_t( width ) * height;
+		_scratch.resize( n );
+		float* src = depths;
+		float* dst = _scratch.data();
+		for ( size_t i = 0; i < stages.size(); ++i ) {
+			const DepthFilterStage& stage = stages[i];
+			if ( !stage.enabled ) continue;
+			uint64_t t0 = ofGetElapsedTimeMicros();
+			pool.parallelFor( 0, height, 8, [&]( size_t b, size_t e ) {
+				applyDepthFilter( stage, src, dst, width, height, int( b ), int( e ) );
+			} );
+			std::swap( src, dst );
+			_stageMicros[i] = ofGetElapsedTimeMicros() - t0;
+			_totalMicros += _stageMicros[i];
+		}
+		if ( src != depths ) {
+			std::memcpy( depths, src, n * sizeof( float ) );  // odd number of stages ran
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,63 @@
+#pragma once
+#include "ofxStructureCoreThreadPool.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// cpu depth filters, run in order on depthImg before the point cloud
+	// * invalid (<= 0 / NaN) pixels stay invalid (0) and don't count as neighbours, holes aren't filled
+	// * rows are split across the pool, borders use clamped neighbours
+	// -----------------------------------------------------------------------
+
+	struct DepthFilterStage
+	{
+		enum Type
+		{
+			Median3,    // 3x3 median
+			Median5,    // 5x5 median
+			Bilateral,  // gaussian in space and depth, smooths surfaces but not across edges
+		};
+
+		Type type    = Median3;
+		bool enabled = true;
+
+		// bilateral
+		int radius       = 2;     // window is ( 2 * radius + 1 )^2 pixels, 1 - 5
+		float sigmaSpace = 1.5f;  // pixels
+		float sigmaDepth = 20.f;  // mm, depth steps well above this are edges
+	};
+
+	std::string to_string( DepthFilterStage::Type type );
+
+	// dispatches to the best kernel for getSimdLevel(), all kernels match the scalar loop bit for bit
+	// src and dst must not overlap, rows [rowBegin, rowEnd) of dst only
+	void applyDepthFilter( const DepthFilterStage& stage, const float* src, float* dst, int width, int height, int rowBegin, int rowEnd );
+	void applyDepthFilterScalar( const DepthFilterStage& stage, const float* src, float* dst, int width, int height, int rowBegin, int rowEnd );
+
+	// -----------------------------------------------------------------------
+
+	class DepthFilterChain
+	{
+	public:
+		// stages can be changed any time between apply() calls
+		std::vector<DepthFilterStage> stages;
+
+		// runs the enabled stages in place, times each one
+		void apply( float* depths, int width, int height, ThreadPool& pool );
+
+		// microseconds the stages took in the last apply(), per stage (0 if disabled)
+		const std::vector<uint64_t>& getStageMicros() const { return _stageMicros; }
+		uint64_t getTotalMicros() const { return _totalMicros; }
+
+	protected:
+		std::vector<float> _scratch;  // ping-pong buffer
+		std::vector<uint64_t> _stageMicros;
+		uint64_t _totalMicros = 0;
+	};
+
+}  // namespace structure
+}  // namespace ofx
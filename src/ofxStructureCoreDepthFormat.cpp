@@ -0,0 +1,93 @@
+#include "ofxStructureCoreDepthFormat.h"
+#include "ofxStructureCoreSimd.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+
+		// the simd kernel makes the same float ops: add, min, truncate
+		inline uint16_t toMillimeters( float d )
+		{
+			if ( !( d > 0.f ) ) return 0;
+			float v = d + 0.5f;
+			v       = v < 65535.f ? v : 65535.f;  // same as _mm_min_ps
+			return uint16_t( int( v ) );
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		// 8 depths per step, sse2 has no unsigned 32 -> 16 pack so values are biased into int16 range and back
+		void depthToMillimetersSSE2( const float* depths, uint16_t* out, size_t n )
+		{
+			const __m128 zero  = _mm_setzero_ps();
+			const __m128 half  = _mm_set1_ps( 0.5f );
+			const __m128 max   = _mm_set1_ps( 65535.f );
+			const __m128i bias = _mm_set1_epi32( 32768 );
+			const __m128i flip = _mm_set1_epi16( -32768 );
+			size_t i           = 0;
+			for ( ; i + 8 <= n; i += 8 ) {
+				const __m128 d0  = _mm_loadu_ps( depths + i );
+				const __m128 d1  = _mm_loadu_ps( depths + i + 4 );
+				const __m128 v0  = _mm_and_ps( _mm_cmpgt_ps( d0, zero ), _mm_min_ps( _mm_add_ps( d0, half ), max ) );
+				const __m128 v1  = _mm_and_ps( _mm_cmpgt_ps( d1, zero ), _mm_min_ps( _mm_add_ps( d1, half ), max ) );
+				const __m128i i0 = _mm_sub_epi32( _mm_cvttps_epi32( v0 ), bias );
+				const __m128i i1 = _mm_sub_epi32( _mm_cvttps_epi32( v1 ), bias );
+				_mm_storeu_si128( ( __m128i* )( out + i ), _mm_xor_si128( _mm_packs_epi32( i0, i1 ), flip ) );
+			}
+			depthToMillimetersScalar( depths + i, out + i, n - i );
+		}
+
+		void millimetersToDepthSSE2( const uint16_t* mm, float* out, size_t n )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			size_t i           = 0;
+			for ( ; i + 8 <= n; i += 8 ) {
+				const __m128i v = _mm_loadu_si128( ( const __m128i* )( mm + i ) );
+				_mm_storeu_ps( out + i, _mm_cvtepi32_ps( _mm_unpacklo_epi16( v, zero ) ) );
+				_mm_storeu_ps( out + i + 4, _mm_cvtepi32_ps( _mm_unpackhi_epi16( v, zero ) ) );
+			}
+			millimetersToDepthScalar( mm + i, out + i, n - i );
+		}
+#endif
+
+	}  // namespace
+
+	void depthToMillimetersScalar( const float* depths, uint16_t* out, size_t n )
+	{
+		for ( size_t i = 0; i < n; ++i ) out[i] = toMillimeters( depths[i] );
+	}
+
+	void millimetersToDepthScalar( const uint16_t* mm, float* out, size_t n )
+	{
+		for ( size_t i = 0; i < n; ++i ) out[i] = float( mm[i] );
+	}
+
+	void depthToMillimeters( const float* depths, uint16_t* out, size_t n )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: depthToMillimetersSSE2( depths, out, n ); return;  // memory bound, sse2 is enough
+#endif
+			default: depthToMillimetersScalar( depths, out, n ); return;
+		}
+	}
+
+	void millimetersToDepth( const uint16_t* mm, float* out, size_t n )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: millimetersToDepthSSE2( mm, out, n ); return;
+#endif
+			default: millimetersToDepthScalar( mm, out, n ); return;
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
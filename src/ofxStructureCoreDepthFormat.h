@@ -0,0 +1,35 @@
+#pragma once
+#include "ofxStructureCoreThreadPool.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// 16 bit millimeter depth (Settings::addon.depthFormat Millimeters16)
+	// * the sensor's precision fits a uint16_t, half the bytes of float on the cpu and in the texture (GL_R16)
+	// * float -> mm rounds to nearest and clamps to 65535, invalid depth (<= 0 or NaN) becomes 0
+	// * mm -> float is exact, so cpu stages on widened depth see the same values as the shader
+	// -----------------------------------------------------------------------
+
+	// dispatches to the best kernel for getSimdLevel(), all kernels match the scalar loop bit for bit
+	void depthToMillimeters( const float* depths, uint16_t* out, size_t n );
+	void depthToMillimetersScalar( const float* depths, uint16_t* out, size_t n );
+
+	void millimetersToDepth( const uint16_t* mm, float* out, size_t n );
+	void millimetersToDepthScalar( const uint16_t* mm, float* out, size_t n );
+
+	// chunks split across the pool
+	inline void depthToMillimeters( const float* depths, uint16_t* out, size_t n, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, n, 16384, [&]( size_t b, size_t e ) { depthToMillimeters( depths + b, out + b, e - b ); } );
+	}
+
+	inline void millimetersToDepth( const uint16_t* mm, float* out, size_t n, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, n, 16384, [&]( size_t b, size_t e ) { millimetersToDepth( mm + b, out + b, e - b ); } );
+	}
+
+}  // namespace structure
+}  // namespace ofx
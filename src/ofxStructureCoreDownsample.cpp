@@ -0,0 +1,178 @@
+#include "ofxStructureCoreDownsample.h"
+#include <algorithm>
+
+namespace ofx {
+namespace structure {
+
+	void decimateDepth( const float* depths, int width, int height, int stride, float* out, ThreadPool& pool )
+	{
+		const int w = decimatedSize( width, stride );
+		const int h = decimatedSize( height, stride );
+		pool.parallelFor( 0, h, 16, [&]( size_t b, size_t e ) {
+			for ( size_t r = b; r < e; ++r ) {
+				const float* src = depths + r * stride * width;
+				float* dst       = out + r * w;
+				for ( int c = 0; c < w; ++c ) dst[c] = src[c * stride];
+			}
+		} );
+	}
+
+	// -----------------------------------------------------------------------
+
+	namespace {
+
+		const uint64_t emptyKey = ~uint64_t( 0 );  // keys only use 63 bits
+
+		// std::floor is a libm call without sse4.1
+		inline int64_t floorToInt( float v )
+		{
+			int64_t i = int64_t( v );
+			return i - ( v < float( i ) );
+		}
+
+		// 21 bits per axis, +-1M voxels around the sensor
+		inline uint64_t voxelKey( const glm::vec3& p, float invLeaf )
+		{
+			const uint64_t bias = 1 << 20;
+			uint64_t x          = ( uint64_t( floorToInt( p.x * invLeaf ) ) + bias ) & 0x1FFFFF;
+			uint64_t y          = ( uint64_t( floorToInt( p.y * invLeaf ) ) + bias ) & 0x1FFFFF;
+			uint64_t z          = ( uint64_t( floorToInt( p.z * invLeaf ) ) + bias ) & 0x1FFFFF;
+			return ( x << 42 ) | ( y << 21 ) | z;
+		}
+
+		// murmur3 finalizer, neighbouring voxels land far apart
+		inline uint64_t hashKey( uint64_t k )
+		{
+			k ^= k >> 33;
+			k *= 0xff51afd7ed558ccdULL;
+			k ^= k >> 33;
+			k *= 0xc4ceb9fe1a85ec53ULL;
+			k ^= k >> 33;
+			return k;
+		}
+
+	}  // namespace
+
+	size_t VoxelGrid::filter( const glm::vec3* points, size_t n, float leafSize, glm::vec3* out, ThreadPool& pool )
+	{
+		if ( n == 0 || !( leafSize > 0.f ) ) return 0;
+
+		// stamps mark the voxels of this call, so the tables never need clearing
+		if ( ++_stamp == 0 ) {
+			for ( auto& table : _chunkTables ) {
+				for ( auto& v : table.slots ) v.stamp = 0;
+			}
+			for ( auto& table : _partTables ) {
+				for ( auto& v : table.slots ) v.stamp = 0;
+			}
+			_stamp = 1;
+		}
+
+		// partition = top bits of the hash, table slot = low bits
+		auto partitionOf = []( uint64_t key ) { return size_t( hashKey( key ) >> 58 ); };
+		static_assert( partitions == 64, "partitionOf() takes 6 bits" );
+
+		const float invLeaf   = 1.f / leafSize;
+		const size_t perChunk = ( n + chunks - 1 ) / chunks;
+
+		// reduce each chunk, then group its voxels by partition
+		pool.parallelFor( 0, chunks, 1, [&]( size_t b, size_t e ) {
+			for ( size_t c = b; c < e; ++c ) {
+				Table& table = _chunkTables[c];
+				table.keys.clear();
+				Voxel* last      = nullptr;
+				const size_t end = std::min( n, ( c + 1 ) * perChunk );
+				for ( size_t i = c * perChunk; i < end; ++i ) {
+					if ( !( points[i].z > 0.f ) ) continue;
+					const uint64_t key = voxelKey( points[i], invLeaf );
+					if ( last && last->key == key ) {
+						last->sum += points[i];
+						++last->count;
+					} else {
+						last = add( table, key, points[i], 1 );
+					}
+				}
+
+				size_t* start = _chunkPartStart[c];
+				std::fill( start, start + partitions + 1, size_t( 0 ) );
+				for ( uint64_t key : table.keys ) ++start[partitionOf( key ) + 1];
+				for ( size_t p = 1; p <= partitions; ++p ) start[p] += start[p - 1];
+
+				size_t cursor[partitions];
+				std::copy( start, start + partitions, cursor );
+				auto& voxels = _chunkVoxels[c];
+				voxels.resize( table.keys.size() );
+				for ( uint64_t key : table.keys ) voxels[cursor[partitionOf( key )]++] = *find( table.slots, key );
+			}
+		} );
+
+		// merge the chunks per partition, voxel counts go one slot up for the scan below
+		_voxelStart[0] = 0;
+		pool.parallelFor( 0, partitions, 1, [&]( size_t b, size_t e ) {
+			for ( size_t p = b; p < e; ++p ) {
+				Table& table = _partTables[p];
+				table.keys.clear();
+				for ( size_t c = 0; c < chunks; ++c ) {
+					for ( size_t k = _chunkPartStart[c][p]; k < _chunkPartStart[c][p + 1]; ++k ) {
+						const Voxel& v = _chunkVoxels[c][k];
+						add( table, v.key, v.sum, v.count );
+					}
+				}
+				_voxelStart[p + 1] = table.keys.size();
+			}
+		} );
+
+		for ( size_t p = 1; p <= partitions; ++p ) _voxelStart[p] += _voxelStart[p - 1];
+
+		// centroids, in order of each voxel's first point
+		pool.parallelFor( 0, partitions, 1, [&]( size_t b, size_t e ) {
+			for ( size_t p = b; p < e; ++p ) {
+				Table& table = _partTables[p];
+				size_t o     = _voxelStart[p];
+				for ( uint64_t key : table.keys ) {
+					const Voxel* v = find( table.slots, key );
+					out[o++]       = v->sum / float( v->count );
+				}
+			}
+		} );
+
+		return _voxelStart[partitions];
+	}
+
+	VoxelGrid::Voxel* VoxelGrid::find( std::vector<Voxel>& slots, uint64_t key ) const
+	{
+		const size_t mask = slots.size() - 1;
+		size_t slot       = hashKey( key ) & mask;
+		while ( slots[slot].stamp == _stamp && slots[slot].key != key ) slot = ( slot + 1 ) & mask;  // linear probing
+		return &slots[slot];
+	}
+
+	VoxelGrid::Voxel* VoxelGrid::add( Table& table, uint64_t key, const glm::vec3& sum, uint32_t count ) const
+	{
+		if ( table.slots.empty() ) table.slots.resize( 256 );
+		Voxel* v = find( table.slots, key );
+		if ( v->stamp == _stamp ) {
+			v->sum += sum;
+			v->count += count;
+			return v;
+		}
+		*v = {key, sum, count, _stamp};
+		table.keys.push_back( key );
+		if ( table.keys.size() * 2 > table.slots.size() ) {
+			grow( table.slots );  // keeps probes short, allocates only as the scene gets busier
+			v = find( table.slots, key );
+		}
+		return v;
+	}
+
+	void VoxelGrid::grow( std::vector<Voxel>& slots ) const
+	{
+		std::vector<Voxel> old( slots.size() * 2 );
+		old.swap( slots );
+		for ( const Voxel& v : old ) {
+			if ( v.stamp == _stamp ) *find( slots, v.key ) = v;
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,67 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxStructureCoreThreadPool.h"
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// point cloud downsampling
+	// * stride: keep every n-th pixel of every n-th row, the cloud stays organized
+	// * voxel grid: one point per occupied voxel, the centroid of its points
+	// both run on the pool and give the same output for any thread count
+	// -----------------------------------------------------------------------
+
+	// depth of every stride-th pixel of every stride-th row
+	// out is decimatedSize( width, stride ) by decimatedSize( height, stride )
+	inline int decimatedSize( int size, int stride ) { return ( size + stride - 1 ) / stride; }
+	void decimateDepth( const float* depths, int width, int height, int stride, float* out, ThreadPool& pool );
+
+	// -----------------------------------------------------------------------
+
+	class VoxelGrid
+	{
+	public:
+		// averages the points falling in each leafSize cube (same units as the points, mm)
+		// points with z <= 0 (invalid depth) are skipped
+		// out needs room for n points and may be points (written after all reads), returns the number of voxels
+		// voxels come out grouped by hash, not in any spatial order
+		size_t filter( const glm::vec3* points, size_t n, float leafSize, glm::vec3* out, ThreadPool& pool );
+
+	protected:
+		// 1. each chunk of points is reduced into its own table (runs of pixels mostly share a voxel)
+		// 2. chunk voxels are merged per hash partition, in chunk order, so no two threads touch a voxel
+		// the chunk count is fixed, so sums are added in the same order for any thread count
+		static const size_t chunks     = 64;
+		static const size_t partitions = 64;
+
+		struct Voxel
+		{
+			uint64_t key;
+			glm::vec3 sum;
+			uint32_t count;
+			uint32_t stamp;  // == _stamp if used by the current call
+		};
+
+		// open addressing, power of 2 size
+		struct Table
+		{
+			std::vector<Voxel> slots;
+			std::vector<uint64_t> keys;  // in order of insertion
+		};
+
+		Table _chunkTables[chunks];
+		std::vector<Voxel> _chunkVoxels[chunks];  // a chunk's voxels grouped by partition
+		size_t _chunkPartStart[chunks][partitions + 1];
+		Table _partTables[partitions];
+		size_t _voxelStart[partitions + 1];
+		uint32_t _stamp = 0;
+
+		Voxel* find( std::vector<Voxel>& slots, uint64_t key ) const;  // key's slot, or the empty slot it goes in
+		Voxel* add( Table& table, uint64_t key, const glm::vec3& sum, uint32_t count ) const;
+		void grow( std::vector<Voxel>& slots ) const;
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,180 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	enum class TimeKey
+	{
+		Sensor,  // FrameData::timestamp (middle of exposure)
+		Arrival  // FrameData::arrivalTimestamp
+	};
+
+	// -----------------------------------------------------------------------
+	// fixed-capacity, timestamp-ordered history of frames
+	// * all slots are allocated by setCapacity(), pixel storage is reused once filled
+	// * push() copies outside the lock into a slot readers can't see, then publishes it
+	// * queries binary search the timestamps, O(log n)
+	// * single writer (SDK thread), any number of readers
+	// -----------------------------------------------------------------------
+
+	template <typename FrameType>
+	class FrameHistory
+	{
+	public:
+		FrameHistory() {}
+		FrameHistory( const FrameHistory& ) = delete;
+		FrameHistory& operator=( const FrameHistory& ) = delete;
+
+		// not thread safe: call before streaming starts
+		void setCapacity( size_t capacity )
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			_capacity = capacity;
+			_slots.assign( capacity ? capacity + 1 : 0, FrameType() );  // +1 spare slot for the writer
+			_sensorT.assign( _slots.size(), 0. );
+			_arrivalT.assign( _slots.size(), 0. );
+			_head  = 0;
+			_count = 0;
+		}
+		size_t capacity() const { return _capacity; }
+		size_t size() const
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			return _count;
+		}
+		bool isEnabled() const { return _capacity > 0; }
+
+		// writer
+
+		void push( const FrameType& frame )
+		{
+			if ( !_capacity ) return;
+			// _head is never visible to readers, copy without the lock
+			size_t slot = _head;
+			_slots[slot] = frame;
+			_sensorT[slot]  = frame.timestamp;
+			_arrivalT[slot] = frame.arrivalTimestamp;
+
+			std::unique_lock<std::mutex> lck( _lock );
+			// timestamps must be increasing to stay searchable, restart on a clock jump
+			if ( _count && frame.timestamp < _sensorT[physical( _count - 1 )] ) {
+				_count = 0;
+			}
+			_head  = ( _head + 1 ) % _slots.size();
+			_count = std::min( _count + 1, _capacity );
+		}
+
+		void clear()
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			_count = 0;
+		}
+
+		// readers
+
+		// copy the frame closest to time t into out, false if empty
+		bool nearest( double t, FrameType& out, TimeKey key = TimeKey::Sensor ) const
+		{
+			return visitNearest( t, [&]( const FrameType& frame ) { out = frame; }, key );
+		}
+
+		// visit the frame closest to time t without copying (frame is only valid inside fn)
+		bool visitNearest( double t, const std::function<void( const FrameType& )>& fn, TimeKey key = TimeKey::Sensor ) const
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			if ( !_count ) return false;
+			size_t i = lowerBound( t, key );
+			if ( i == _count ) {
+				i = _count - 1;
+			} else if ( i > 0 && ( t - time( i - 1, key ) ) <= ( time( i, key ) - t ) ) {
+				i = i - 1;
+			}
+			fn( _slots[physical( i )] );
+			return true;
+		}
+
+		// visit all frames with t0 <= time <= t1, oldest first, returns number visited
+		size_t visitRange( double t0, double t1, const std::function<void( const FrameType& )>& fn, TimeKey key = TimeKey::Sensor ) const
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			size_t n = 0;
+			for ( size_t i = lowerBound( t0, key ); i < _count && time( i, key ) <= t1; ++i, ++n ) {
+				fn( _slots[physical( i )] );
+			}
+			return n;
+		}
+
+		// copy all frames with t0 <= time <= t1 into out, reusing out's storage
+		size_t range( double t0, double t1, std::vector<FrameType>& out, TimeKey key = TimeKey::Sensor ) const
+		{
+			size_t n = 0;
+			visitRange(
+			    t0, t1, [&]( const FrameType& frame ) {
+				    if ( n < out.size() ) {
+					    out[n] = frame;
+				    } else {
+					    out.push_back( frame );
+				    }
+				    ++n;
+			    },
+			    key );
+			out.resize( n );
+			return n;
+		}
+
+		// frames from the last `seconds` before the newest frame
+		size_t latest( double seconds, std::vector<FrameType>& out, TimeKey key = TimeKey::Sensor ) const
+		{
+			double newest = 0.;
+			{
+				std::unique_lock<std::mutex> lck( _lock );
+				if ( !_count ) {
+					out.clear();
+					return 0;
+				}
+				newest = time( _count - 1, key );
+			}
+			return range( newest - seconds, newest, out, key );
+		}
+
+	protected:
+		std::vector<FrameType> _slots;
+		std::vector<double> _sensorT, _arrivalT;  // timestamps by slot, kept apart so searches stay in cache
+		size_t _capacity = 0;
+		size_t _head     = 0;  // next slot to write (never visible)
+		size_t _count    = 0;  // visible frames
+		mutable std::mutex _lock;
+
+		// logical index (0 = oldest) to slot index
+		size_t physical( size_t i ) const
+		{
+			size_t n = _slots.size();
+			return ( _head + n - _count + i ) % n;
+		}
+		double time( size_t i, TimeKey key ) const
+		{
+			return key == TimeKey::Sensor ? _sensorT[physical( i )] : _arrivalT[physical( i )];
+		}
+		// first logical index with time >= t
+		size_t lowerBound( double t, TimeKey key ) const
+		{
+			size_t lo = 0, hi = _count;
+			while ( lo < hi ) {
+				size_t mid = ( lo + hi ) / 2;
+				if ( time( mid, key ) < t ) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	struct FrameRateStats
+	{
+		double fps         = 0.;  // frames received per second over the last window, from sensor timestamps
+		double consumedFps = 0.;  // frames picked up by update() per second over the last window
+		double expectedFps = 0.;  // the configured framerate (Settings::structureCore.*Framerate)
+		uint64_t received  = 0;   // frames handed over by the source
+		uint64_t gaps      = 0;   // times consecutive timestamps were more than 1.5 frame intervals apart
+		uint64_t missed    = 0;   // frames missing in those gaps, lost before they reached the addon
+		uint64_t dropped   = 0;   // received, but overwritten before update() consumed them (see FrameStats)
+	};
+
+	// -----------------------------------------------------------------------
+	// rolling window rate of one stream's timestamps
+	// * add() from one thread, every timestamp in the last `window` seconds counts towards fps()
+	// * with an expected rate, a jump of more than 1.5 intervals is a gap, the frames that fit in it are missed
+	// * the results are atomics, so readers on other threads never block the producer
+	// -----------------------------------------------------------------------
+
+	class FrameRateEstimator
+	{
+	public:
+		// not thread safe, call before timestamps arrive (expectedFps 0 = no gap detection)
+		void reset( double expectedFps = 0., double window = 1. )
+		{
+			_expected = expectedFps;
+			_window   = window;
+			_begin = _size = 0;
+			_fps.store( 0., std::memory_order_relaxed );
+			_count.store( 0, std::memory_order_relaxed );
+			_gaps.store( 0, std::memory_order_relaxed );
+			_missed.store( 0, std::memory_order_relaxed );
+		}
+
+		void add( double t )
+		{
+			if ( _size ) {
+				const double dt = t - newest();
+				if ( dt < 0. ) {
+					_size = 0;  // timestamps went back (the stream restarted), start over
+				} else if ( _expected > 0. && dt * _expected > 1.5 ) {
+					_gaps.fetch_add( 1, std::memory_order_relaxed );
+					_missed.fetch_add( uint64_t( dt * _expected + 0.5 ) - 1, std::memory_order_relaxed );
+				}
+			}
+			if ( _size == kCapacity ) pop();
+			_times[( _begin + _size++ ) % kCapacity] = t;
+			while ( _size > 1 && _times[_begin] < t - _window ) pop();
+
+			const double span = t - _times[_begin];
+			_fps.store( _size > 1 && span > 0. ? ( _size - 1 ) / span : 0., std::memory_order_relaxed );
+			_count.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		// any thread, as of the last add() (a stalled stream keeps its last rate)
+		double fps() const { return _fps.load( std::memory_order_relaxed ); }
+		uint64_t count() const { return _count.load( std::memory_order_relaxed ); }
+		uint64_t gaps() const { return _gaps.load( std::memory_order_relaxed ); }
+		uint64_t missed() const { return _missed.load( std::memory_order_relaxed ); }
+		double expectedFps() const { return _expected; }
+
+	protected:
+		static constexpr size_t kCapacity = 512;  // timestamps per window, plenty for 1 s at the sensor's rates
+
+		std::array<double, kCapacity> _times;  // ring, owned by the producer
+		size_t _begin = 0, _size = 0;
+		double _expected = 0., _window = 1.;
+
+		std::atomic<double> _fps{0.};
+		std::atomic<uint64_t> _count{0}, _gaps{0}, _missed{0};
+
+		double newest() const { return _times[( _begin + _size - 1 ) % kCapacity]; }
+		void pop()
+		{
+			_begin = ( _begin + 1 ) % kCapacity;
+			--_size;
+		}
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,59 @@
+#pragma once
+#include "ST/CaptureSessionTypes.h"
+#include "ofxStructureCoreFrames.h"
+#include "ofxStructureCoreSettings.h"
+#include <chrono>
+#include <string>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// where frames come from
+	// * a Structure Core (SensorFrameSource) or a generator (SyntheticFrameSource)
+	// * sources call the delegate from their own thread(s), the same way the SDK does
+	// * frames are handed over as FrameHandles, the delegate keeps whichever it wants without copying
+	// -----------------------------------------------------------------------
+
+	class FrameSource
+	{
+	public:
+		using EventType = ST::CaptureSessionEventId;
+
+		// receives events / frames (implemented by ofxStructureCore)
+		class Delegate
+		{
+		public:
+			virtual ~Delegate() {}
+			virtual void handleSessionEvent( EventType evt )               = 0;
+			virtual void handleNewFrame( const DepthFrameHandle& frame )    = 0;
+			virtual void handleNewFrame( const InfraredFrameHandle& frame ) = 0;
+			virtual void handleNewFrame( const VisibleFrameHandle& frame )  = 0;
+			virtual void handleNewSample( const ImuSample& sample )         = 0;
+		};
+
+		virtual ~FrameSource() {}
+
+		void setDelegate( Delegate* delegate ) { _delegate = delegate; }
+
+		virtual bool setup( const Settings& settings ) = 0;  // init, Ready event follows (maybe async)
+		virtual bool startStreaming()                  = 0;  // Streaming event follows (maybe async)
+		virtual void stopStreaming()                   = 0;  // no frames / samples are delivered once it returns
+		virtual std::string serial() const             = 0;  // empty if unknown
+
+		// "imu from camera" extrinsics (translation in meters), valid once the source is Ready, identity if unknown
+		virtual ST::Matrix4 imuFromDepth() const { return ST::Matrix4::identity(); }
+		virtual ST::Matrix4 imuFromVisible() const { return ST::Matrix4::identity(); }
+
+		// current time in the clock of the frame timestamps, seconds
+		virtual double now() const
+		{
+			return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+		}
+
+	protected:
+		Delegate* _delegate = nullptr;
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,326 @@
+#pragma once
+#include "ST/CameraFrames.h"
+#include "ST/MathTypes.h"
+#include "ofxStructureCoreYCbCr.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	enum class Stream
+	{
+		Depth,
+		Infrared,
+		Visible,
+		Count
+	};
+
+	inline std::string to_string( Stream stream )
+	{
+		switch ( stream ) {
+			case Stream::Depth: return "Depth";
+			case Stream::Infrared: return "Infrared";
+			case Stream::Visible: return "Visible";
+			default: return "";
+		}
+	}
+
+	// frames turned into a stream's ofImage(s), see Settings::addon.lazyImages
+	struct ConversionStats
+	{
+		uint64_t converted = 0;  // frames copied / converted (and uploaded) because something read them
+		uint64_t skipped   = 0;  // frames replaced by a newer one before anything read them
+	};
+
+	// -----------------------------------------------------------------------
+	// addon-owned frame pixels
+	// * pixel storage is reused, so a pooled frame only allocates when the resolution changes
+	// * backs generated frames (see SyntheticFrameSource) and explicit copies (copyFrame())
+	// -----------------------------------------------------------------------
+
+	template <typename PixelType>
+	struct FrameData
+	{
+		using pixel_type = PixelType;
+
+		std::vector<PixelType> pixels;
+		int width    = 0;
+		int height   = 0;
+		int channels = 1;
+
+		double timestamp        = 0.;  // sensor timestamp (middle of exposure), in seconds
+		double arrivalTimestamp = 0.;  // time the CaptureSession received the frame, in seconds
+
+		ST::Intrinsics intrinsics;
+		ST::Matrix4 visiblePose = ST::Matrix4::identity();  // depth only: visible camera in depth coordinates, translation in meters
+		bool ycbcr              = false;                    // visible only: luma plane + CbCr plane (channels = 1), see ofxStructureCoreYCbCr.h
+
+		bool isValid() const { return width > 0 && height > 0 && !pixels.empty(); }
+		const PixelType* data() const { return pixels.data(); }
+		PixelType* data() { return pixels.data(); }
+		size_t size() const { return pixels.size(); }
+		size_t bytes() const { return pixels.size() * sizeof( PixelType ); }
+		const PixelType* chroma() const { return pixels.data() + size_t( width ) * height; }  // ycbcr: the CbCr plane
+		PixelType* chroma() { return pixels.data() + size_t( width ) * height; }
+
+		// resize storage (no-op if dims are unchanged)
+		void allocate( int w, int h, int ch )
+		{
+			width    = w;
+			height   = h;
+			channels = ch;
+			ycbcr    = false;
+			pixels.resize( size_t( w ) * h * ch );
+		}
+
+		void allocateYCbCr( int w, int h )
+		{
+			width    = w;
+			height   = h;
+			channels = 1;
+			ycbcr    = true;
+			pixels.resize( size_t( w ) * h + chromaSize( w, h ) );
+		}
+
+		void copyFrom( const PixelType* src, int w, int h, int ch )
+		{
+			allocate( w, h, ch );
+			if ( src ) {
+				std::copy( src, src + pixels.size(), pixels.begin() );
+			}
+		}
+	};
+
+	using DepthFrameData    = FrameData<float>;     // millimeters
+	using InfraredFrameData = FrameData<uint16_t>;  // 16 bit intensity
+	using VisibleFrameData  = FrameData<uint8_t>;   // 8 bit rgb, or luma + CbCr planes
+
+	// -----------------------------------------------------------------------
+	// non-owning, stride aware view of a frame's pixels
+	// * only valid as long as whatever owns the pixels, see FrameHandle
+	// -----------------------------------------------------------------------
+
+	template <typename PixelType>
+	struct FrameView
+	{
+		const PixelType* data = nullptr;
+		int width             = 0;
+		int height            = 0;
+		int channels          = 1;
+		size_t stride         = 0;  // elements from one row to the next, 0 = packed ( width * channels )
+
+		double timestamp        = 0.;
+		double arrivalTimestamp = 0.;
+
+		// the rest of the frame's way in, in the source's clock (FrameSource::now()), 0 = not reached / unknown
+		double endOfExposureTimestamp      = 0.;  // visible only (sdk)
+		double endOfPreprocessingTimestamp = 0.;  // visible only (sdk), ready to be handed on
+		double callbackTimestamp           = 0.;  // handed to ofxStructureCore, see LatencyStage
+		double consumedTimestamp           = 0.;  // picked up by update() (front() of its triple buffer only)
+		double uploadedTimestamp           = 0.;  // its image filled / uploaded (front() only)
+
+		ST::Intrinsics intrinsics;
+		ST::Matrix4 visiblePose = ST::Matrix4::identity();
+		const PixelType* chroma = nullptr;  // visible only: set for a ycbcr frame (packed), data is then the luma plane
+
+		bool isValid() const { return data && width > 0 && height > 0; }
+		size_t rowStride() const { return stride ? stride : size_t( width ) * channels; }
+		bool isPacked() const { return rowStride() == size_t( width ) * channels; }
+		const PixelType* row( int y ) const { return data + y * rowStride(); }
+		size_t size() const { return size_t( width ) * height * channels; }  // packed pixel count, excluding chroma
+	};
+
+	using DepthFrameView    = FrameView<float>;
+	using InfraredFrameView = FrameView<uint16_t>;
+	using VisibleFrameView  = FrameView<uint8_t>;
+
+	template <typename PixelType>
+	inline FrameView<PixelType> viewOf( const FrameData<PixelType>& frame )
+	{
+		FrameView<PixelType> view;
+		view.data             = frame.data();
+		view.chroma           = frame.ycbcr ? frame.chroma() : nullptr;
+		view.width            = frame.width;
+		view.height           = frame.height;
+		view.channels         = frame.channels;
+		view.timestamp        = frame.timestamp;
+		view.arrivalTimestamp = frame.arrivalTimestamp;
+		view.intrinsics       = frame.intrinsics;
+		view.visiblePose      = frame.visiblePose;
+		return view;
+	}
+
+	// packed copy of rows [rowBegin, rowEnd) of the view's pixels (not the chroma plane), dst is the packed image
+	template <typename PixelType>
+	inline void copyRows( const FrameView<PixelType>& src, PixelType* dst, int rowBegin, int rowEnd )
+	{
+		const size_t rowSize = size_t( src.width ) * src.channels;
+		if ( src.isPacked() ) {
+			std::copy( src.row( rowBegin ), src.row( rowEnd ), dst + rowBegin * rowSize );
+			return;
+		}
+		for ( int y = rowBegin; y < rowEnd; ++y ) {
+			std::copy( src.row( y ), src.row( y ) + rowSize, dst + y * rowSize );
+		}
+	}
+
+	// packed copy of the view's pixels (not the chroma plane), dst holds src.size() elements
+	template <typename PixelType>
+	inline void copyPixels( const FrameView<PixelType>& src, PixelType* dst )
+	{
+		copyRows( src, dst, 0, src.height );
+	}
+
+	template <typename PixelType>
+	inline void copyFrame( const FrameView<PixelType>& src, FrameData<PixelType>& dst )
+	{
+		if ( src.chroma ) {
+			dst.allocateYCbCr( src.width, src.height );
+			std::copy( src.chroma, src.chroma + chromaSize( src.width, src.height ), dst.chroma() );
+		} else {
+			dst.allocate( src.width, src.height, src.channels );
+		}
+		if ( src.data ) {
+			copyPixels( src, dst.data() );
+		}
+		dst.timestamp        = src.timestamp;
+		dst.arrivalTimestamp = src.arrivalTimestamp;
+		dst.intrinsics       = src.intrinsics;
+		dst.visiblePose      = src.visiblePose;
+	}
+
+	// -----------------------------------------------------------------------
+	// IRMode::BothCameras infrared frames are 2x wide, each row is <right row><left row>
+	// * either camera is a strided view into the same buffer, no copy
+	// -----------------------------------------------------------------------
+
+	enum class InfraredCamera
+	{
+		Right,
+		Left
+	};
+
+	// works on a FrameView or a resolved FrameHandle (which keeps sharing the buffer)
+	template <typename FrameType>
+	inline FrameType infraredCamera( const FrameType& frame, InfraredCamera camera )
+	{
+		FrameType half = frame;
+		half.width     = frame.width / 2;
+		half.stride    = frame.rowStride();
+		if ( camera == InfraredCamera::Left && half.data ) {
+			half.data += size_t( half.width ) * frame.channels;
+		}
+		return half;
+	}
+
+	// -----------------------------------------------------------------------
+	// immutable, reference counted frame as delivered by a FrameSource
+	// * shares the source's buffer (a clone of the SDK frame, or a pooled FrameData)
+	//   instead of copying it, the buffer lives until the last handle to it is gone
+	// * copying a handle only bumps the ref count, they can be kept and passed between threads
+	// * read the pixels in place through the view, copy them out (copyPixels()) only when needed
+	// * a source can leave data / chroma / channels to a resolver (the sdk converts depth / rgb on access),
+	//   resolve() looks them up on the reading thread the first time, the getters return resolved handles
+	// -----------------------------------------------------------------------
+
+	template <typename PixelType>
+	struct FrameHandle : FrameView<PixelType>
+	{
+		// fills the view's data / chroma / channels from owner, thread safe (the owner does it once for all its handles)
+		using Resolver = void ( * )( const void* owner, FrameView<PixelType>& view );
+
+		std::shared_ptr<const void> owner;  // keeps data / chroma alive
+		Resolver resolver = nullptr;        // set until data / chroma are looked up
+
+		bool isValid() const { return owner && this->width > 0 && this->height > 0 && ( this->data || resolver ); }
+		bool isResolved() const { return !resolver; }
+		long useCount() const { return owner.use_count(); }
+		void reset() { *this = FrameHandle(); }
+
+		// call before reading data / chroma / channels of a handle that didn't come from a getter (e.g. the history)
+		FrameHandle& resolve()
+		{
+			if ( resolver ) {
+				resolver( owner.get(), *this );
+				resolver = nullptr;
+			}
+			return *this;
+		}
+		FrameHandle resolved() const { return FrameHandle( *this ).resolve(); }
+	};
+
+	using DepthFrameHandle    = FrameHandle<float>;
+	using InfraredFrameHandle = FrameHandle<uint16_t>;
+	using VisibleFrameHandle  = FrameHandle<uint8_t>;
+
+	// view must point into owner, or be left to the resolver
+	template <typename PixelType>
+	inline FrameHandle<PixelType> makeFrameHandle( std::shared_ptr<const void> owner, const FrameView<PixelType>& view, typename FrameHandle<PixelType>::Resolver resolver = nullptr )
+	{
+		FrameHandle<PixelType> handle;
+		static_cast<FrameView<PixelType>&>( handle ) = view;
+		handle.owner                                 = std::move( owner );
+		handle.resolver                              = resolver;
+		return handle;
+	}
+
+	template <typename PixelType>
+	inline FrameHandle<PixelType> makeFrameHandle( const std::shared_ptr<const FrameData<PixelType>>& frame )
+	{
+		return makeFrameHandle( frame, viewOf( *frame ) );
+	}
+
+	// -----------------------------------------------------------------------
+	// recycles the buffers behind frame handles, so steady streaming doesn't allocate
+	// * acquire() returns an item no handle refers to anymore (oldest first), or a new one
+	// * single producer: acquire() and fill from one thread, the handles can go anywhere
+	// -----------------------------------------------------------------------
+
+	template <typename T>
+	class FramePool
+	{
+	public:
+		std::shared_ptr<T> acquire()
+		{
+			for ( size_t i = 0; i < _items.size(); ++i ) {
+				_next = ( _next + 1 ) % _items.size();
+				if ( _items[_next].use_count() == 1 ) {
+					// the last handle's release happens before we write into the item again
+					std::atomic_thread_fence( std::memory_order_acquire );
+					return _items[_next];
+				}
+			}
+			_items.push_back( std::make_shared<T>() );
+			_next = _items.size() - 1;
+			return _items.back();
+		}
+
+		size_t size() const { return _items.size(); }  // items allocated so far
+		void clear() { _items.clear(); }                // items still referenced live on with their handles
+
+	protected:
+		std::vector<std::shared_ptr<T>> _items;
+		size_t _next = 0;
+	};
+
+	// single accelerometer or gyroscope reading
+	struct ImuSample
+	{
+		enum class Type
+		{
+			Accelerometer,  // x,y,z in g
+			Gyroscope       // x,y,z in rad/s
+		} type = Type::Accelerometer;
+
+		double x = 0., y = 0., z = 0.;
+		double timestamp        = 0.;
+		double arrivalTimestamp = 0.;
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,123 @@
+#include "ofxStructureCoreGroup.h"
+
+bool ofxStructureCoreGroup::setup( const std::vector<Settings>& settings, float timeout )
+{
+	stop();
+	_sensors.clear();  // stops their sources
+
+	// the cores shared out between the sensors' pools (each counts the thread it's called from)
+	const size_t cores = std::max( 1u, std::thread::hardware_concurrency() );
+	_settings          = settings;
+	for ( auto& s : _settings ) {
+		if ( s.addon.threads == 0 ) {
+			s.addon.threads = std::max<size_t>( 1, cores / settings.size() );
+		}
+	}
+	_pool.reset( new ofx::structure::ThreadPool( std::min( cores, std::max<size_t>( settings.size(), 1 ) ) ) );
+
+	for ( size_t i = 0; i < settings.size(); ++i ) {
+		_sensors.emplace_back( new ofxStructureCore() );
+		if ( _sourceFactory ) {
+			_sensors.back()->setFrameSource( _sourceFactory( i ) );
+		}
+	}
+
+	return bringUp( true, timeout );
+}
+
+bool ofxStructureCoreGroup::setup( const Settings& defaults, float timeout )
+{
+	const auto serials = ofxStructureCore::listDevices( false );
+	if ( serials.empty() ) {
+		ofLogError( ofx_module() ) << "No Structure Core devices found!";
+		return false;
+	}
+	std::vector<Settings> settings( serials.size(), defaults );
+	for ( size_t i = 0; i < serials.size(); ++i ) {
+		settings[i].setSerial( serials[i] );
+	}
+	return setup( settings, timeout );
+}
+
+bool ofxStructureCoreGroup::start( float timeout )
+{
+	return bringUp( false, timeout );
+}
+
+void ofxStructureCoreGroup::stop()
+{
+	for ( auto& sensor : _sensors ) {
+		sensor->stop();
+	}
+}
+
+bool ofxStructureCoreGroup::bringUp( bool setup, float timeout )
+{
+	using Clock   = std::chrono::steady_clock;
+	const auto t0 = Clock::now();
+	auto elapsed  = [t0]() { return std::chrono::duration<double>( Clock::now() - t0 ).count(); };
+	auto left     = [&]() { return timeout - float( elapsed() ); };
+
+	// each sensor waits on its own signals, so a slow one doesn't hold up the others
+	_startup.assign( _sensors.size(), Startup() );
+	std::vector<std::thread> threads;
+	for ( size_t i = 0; i < _sensors.size(); ++i ) {
+		threads.emplace_back( [&, i]() {
+			auto& sensor    = *_sensors[i];
+			auto& startup   = _startup[i];
+			const bool init = !setup || sensor.setup( _settings[i] );
+			startup.serial  = sensor.serial();
+			if ( !init ) return;
+			if ( setup ) {
+				startup.setup = elapsed();
+			}
+			if ( !sensor.isStreaming() ) {
+				if ( !sensor.waitUntilReady( left() ) ) return;
+				startup.ready = elapsed();
+				if ( !sensor.start() || !sensor.waitUntilStreaming( left() ) ) return;
+			}
+			startup.streaming = elapsed();
+			startup.ok        = true;
+		} );
+	}
+	for ( auto& thread : threads ) {
+		thread.join();
+	}
+	_startupTime = elapsed();
+
+	bool ok = true;
+	for ( size_t i = 0; i < _startup.size(); ++i ) {
+		const auto& startup = _startup[i];
+		if ( startup.ok ) {
+			ofLogNotice( ofx_module() ) << "Sensor [" << startup.serial << "] streaming after " << startup.streaming << " s (setup " << startup.setup << " s, ready " << startup.ready << " s).";
+		} else {
+			ofLogError( ofx_module() ) << "Sensor " << i << " [" << startup.serial << "] didn't start within " << timeout << " seconds!";
+			ok = false;
+		}
+	}
+	ofLogNotice( ofx_module() ) << _sensors.size() << " sensor(s) brought up in " << _startupTime << " s.";
+	return ok;
+}
+
+void ofxStructureCoreGroup::update()
+{
+	if ( _sensors.empty() ) {
+		return;
+	}
+
+	// one sensor per worker, each still splits its stages across its own pool
+	_pool->parallelFor( 0, _sensors.size(), 1, [&]( size_t b, size_t e ) {
+		for ( size_t i = b; i < e; ++i ) _sensors[i]->process();
+	} );
+	for ( auto& sensor : _sensors ) {
+		sensor->upload();  // gl thread only
+	}
+}
+
+bool ofxStructureCoreGroup::isFrameNew() const
+{
+	for ( const auto& sensor : _sensors ) {
+		if ( sensor->isFrameNew() ) return true;
+	}
+	return false;
+}
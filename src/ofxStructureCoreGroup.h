@@ -0,0 +1,80 @@
+#pragma once
+#include "ofxStructureCore.h"
+#include <functional>
+
+// -----------------------------------------------------------------------
+// several sensors brought up and updated together
+// * setup() runs each sensor's setup() -> Ready -> start() -> Streaming on its own thread,
+//   so the sdk's per-sensor waits overlap instead of adding up
+// * update() runs every sensor's process() side by side on the group's pool, then their upload()s
+//   one after another on the calling (gl) thread
+// * Settings::addon.threads left at 0 gives each sensor an equal share of the cores,
+//   so its own stages still split across them while the others process
+// -----------------------------------------------------------------------
+
+class ofxStructureCoreGroup
+{
+public:
+	using Settings    = ofxStructureCore::Settings;
+	using FrameSource = ofxStructureCore::FrameSource;
+
+	// seconds from the start of setup() / start(), 0 = not reached
+	struct Startup
+	{
+		std::string serial;
+		bool ok          = false;  // streaming within the timeout
+		double setup     = 0.;     // setup() returned
+		double ready     = 0.;     // Ready signal
+		double streaming = 0.;     // Streaming signal
+	};
+
+	ofxStructureCoreGroup() = default;
+	~ofxStructureCoreGroup() { stop(); }
+
+	ofxStructureCoreGroup( const ofxStructureCoreGroup& ) = delete;
+	ofxStructureCoreGroup& operator=( const ofxStructureCoreGroup& ) = delete;
+
+	// source for the sensor at index (e.g. ofx::structure::SyntheticFrameSource), call before setup()
+	using SourceFactory = std::function<std::unique_ptr<FrameSource>( size_t index )>;
+	void setFrameSourceFactory( SourceFactory factory ) { _sourceFactory = std::move( factory ); }
+
+	// one sensor per settings (setSerial() picks the device), all set up + started concurrently
+	// addon.threads = 0 becomes hardware threads / number of sensors (at least 1)
+	// blocks until every sensor streams or timeout sec passed, true if all of them do
+	bool setup( const std::vector<Settings>& settings, float timeout = 10.f );
+
+	// every connected sensor (listDevices()), each with defaults and its serial
+	bool setup( const Settings& defaults, float timeout = 10.f );
+
+	bool start( float timeout = 10.f );  // restart all after stop(), concurrently, same as setup()
+	void stop();
+	void update();
+
+	bool isFrameNew() const;  // any sensor got a new frame in the last update()
+
+	size_t size() const { return _sensors.size(); }
+	bool empty() const { return _sensors.empty(); }
+	ofxStructureCore& operator[]( size_t i ) { return *_sensors[i]; }
+	const ofxStructureCore& operator[]( size_t i ) const { return *_sensors[i]; }
+
+	// of the last setup() / start(), by sensor
+	const Startup& getStartup( size_t i ) const { return _startup[i]; }
+	double getStartupTime() const { return _startupTime; }  // the whole bring-up, seconds
+
+protected:
+	std::vector<std::unique_ptr<ofxStructureCore>> _sensors;
+	std::vector<Settings> _settings;
+	std::vector<Startup> _startup;
+	double _startupTime = 0.;
+	SourceFactory _sourceFactory;
+
+	std::unique_ptr<ofx::structure::ThreadPool> _pool;  // one thread per sensor, up to the core count, for process()
+
+	bool bringUp( bool setup, float timeout );
+
+	static inline const std::string& ofx_module()
+	{
+		static const std::string name = "ofxStructureCoreGroup";
+		return name;
+	}
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxStructureCoreFrames.h"
+#include <atomic>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	// imu readings at a point in time (e.g. a frame's timestamp), see ofxStructureCore::getImuAt()
+	struct ImuState
+	{
+		double timestamp       = 0.;
+		glm::vec3 acceleration = glm::vec3( 0.f );  // in g
+		glm::vec3 rotationRate = glm::vec3( 0.f );  // in rad/s
+		bool interpolated      = false;             // both sensors had samples on either side of timestamp, else the nearest ones (or zero)
+	};
+
+	// -----------------------------------------------------------------------
+	// rotation from the imu into each stream's camera coordinates
+	// * set() from one thread (the source's, on every Ready incl. reconnects), get() from any thread without locking
+	// * seqlock over atomic floats like ImuQueue's slots, get() retries while set() rewrites them
+	// -----------------------------------------------------------------------
+
+	class ImuExtrinsics
+	{
+	public:
+		ImuExtrinsics()
+		{
+			const glm::mat3 identity( 1.f );
+			for ( size_t i = 0; i < size_t( Stream::Count ); ++i ) set( Stream( i ), identity );
+		}
+		ImuExtrinsics( const ImuExtrinsics& ) = delete;
+		ImuExtrinsics& operator=( const ImuExtrinsics& ) = delete;
+
+		void set( Stream stream, const glm::mat3& imuToCamera )
+		{
+			const uint32_t seq = _seq.load( std::memory_order_relaxed );
+			_seq.store( seq + 1, std::memory_order_relaxed );  // odd: being written
+			std::atomic_thread_fence( std::memory_order_release );
+			for ( int i = 0; i < 9; ++i ) _m[size_t( stream )][i].store( imuToCamera[i / 3][i % 3], std::memory_order_relaxed );
+			_seq.store( seq + 2, std::memory_order_release );
+		}
+
+		glm::mat3 get( Stream stream ) const
+		{
+			glm::mat3 r;
+			uint32_t seq;
+			do {
+				seq = _seq.load( std::memory_order_acquire );
+				for ( int i = 0; i < 9; ++i ) r[i / 3][i % 3] = _m[size_t( stream )][i].load( std::memory_order_relaxed );
+				std::atomic_thread_fence( std::memory_order_acquire );
+			} while ( ( seq & 1 ) || _seq.load( std::memory_order_relaxed ) != seq );
+			return r;
+		}
+
+	protected:
+		std::atomic<uint32_t> _seq{0};
+		std::atomic<float> _m[size_t( Stream::Count )][9];  // column major, like glm
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,209 @@
+#pragma once
+#include "ofxStructureCoreFrames.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	struct ImuQueueStats
+	{
+		uint64_t pushed  = 0;  // samples written by the producer
+		uint64_t drained = 0;  // samples handed out by drain()
+		uint64_t lost    = 0;  // samples overwritten before drain() got to them
+	};
+
+	// -----------------------------------------------------------------------
+	// lock-free ring of every imu sample of one sensor (accelerometer or gyroscope)
+	// * single producer (SDK imu thread): push() is wait-free and never blocks on readers,
+	//   a full ring overwrites its oldest sample
+	// * single consumer drain()s everything pushed since the last drain
+	// * latest() / range() / interpolate() can be called from any thread and don't consume
+	// * each slot is guarded by a sequence number (seqlock), readers skip a slot
+	//   that's being overwritten, the sample words are atomics so there's no data race
+	// * timestamps are increasing (one sensor), so range() binary searches
+	// -----------------------------------------------------------------------
+
+	class ImuQueue
+	{
+	public:
+		using Stats = ImuQueueStats;
+
+		explicit ImuQueue( size_t capacity = 4096 ) { setCapacity( capacity ); }
+		ImuQueue( const ImuQueue& ) = delete;
+		ImuQueue& operator=( const ImuQueue& ) = delete;
+
+		// not thread safe: call before streaming starts, rounded up to a power of two
+		void setCapacity( size_t capacity )
+		{
+			size_t n = 2;
+			while ( n < capacity ) n *= 2;
+			_slots.reset( new Slot[n] );
+			_mask = n - 1;
+			_head.store( 0, std::memory_order_relaxed );
+			_tail = 0;
+			_drained.store( 0, std::memory_order_relaxed );
+			_lost.store( 0, std::memory_order_relaxed );
+		}
+		size_t capacity() const { return _mask + 1; }
+
+		// producer side
+
+		void push( const ImuSample& sample )
+		{
+			const uint64_t n = _head.load( std::memory_order_relaxed );
+			Slot& slot       = _slots[n & _mask];
+			uint64_t words[kWords];
+			std::memcpy( words, &sample, sizeof( sample ) );
+			slot.seq.store( 2 * n + 1, std::memory_order_relaxed );  // odd: being written
+			std::atomic_thread_fence( std::memory_order_release );
+			for ( size_t i = 0; i < kWords; ++i ) slot.words[i].store( words[i], std::memory_order_relaxed );
+			slot.seq.store( 2 * n + 2, std::memory_order_release );
+			_head.store( n + 1, std::memory_order_release );
+		}
+
+		// consumer side
+
+		// replaces out with every sample pushed since the last drain, oldest first (reuses out's storage)
+		size_t drain( std::vector<ImuSample>& out )
+		{
+			out.clear();
+			const uint64_t head = _head.load( std::memory_order_acquire );
+			skipOverwritten( head );
+			ImuSample sample;
+			for ( ; _tail < head; ++_tail ) {
+				if ( read( _tail, sample ) ) {
+					out.push_back( sample );
+				} else {
+					_lost.fetch_add( 1, std::memory_order_relaxed );  // overwritten while we were reading
+				}
+			}
+			_drained.fetch_add( out.size(), std::memory_order_relaxed );
+			return out.size();
+		}
+
+		// readers (any thread)
+
+		// newest sample, false if none yet
+		bool latest( ImuSample& out ) const
+		{
+			const uint64_t head = _head.load( std::memory_order_acquire );
+			return head && read( head - 1, out );
+		}
+
+		// samples with t0 <= timestamp <= t1 still in the ring, oldest first (reuses out's storage)
+		size_t range( double t0, double t1, std::vector<ImuSample>& out ) const
+		{
+			out.clear();
+			const uint64_t head = _head.load( std::memory_order_acquire );
+			ImuSample sample;
+			for ( uint64_t n = lowerBound( t0, head ); n < head; ++n ) {
+				if ( !read( n, sample ) ) continue;  // overwritten, it was older than t0 anyway
+				if ( sample.timestamp > t1 ) break;
+				out.push_back( sample );
+			}
+			return out.size();
+		}
+
+		// the sample at t, linear between the samples around it (timestamp = t)
+		// false if t isn't between two samples still in the ring: out is then the nearest one, or untouched if there's none
+		bool interpolate( double t, ImuSample& out ) const
+		{
+			const uint64_t head = _head.load( std::memory_order_acquire );
+			const uint64_t n    = lowerBound( t, head );  // first with timestamp >= t
+			ImuSample before, after;
+			const bool hasAfter  = n < head && read( n, after );
+			const bool hasBefore = n > 0 && read( n - 1, before );  // fails once overwritten
+			if ( hasAfter && after.timestamp == t ) {
+				out = after;
+				return true;
+			}
+			if ( hasBefore && hasAfter ) {
+				const double a = ( t - before.timestamp ) / ( after.timestamp - before.timestamp );
+				out            = before;
+				out.x += a * ( after.x - before.x );
+				out.y += a * ( after.y - before.y );
+				out.z += a * ( after.z - before.z );
+				out.timestamp = t;
+				out.arrivalTimestamp += a * ( after.arrivalTimestamp - before.arrivalTimestamp );
+				return true;
+			}
+			if ( hasBefore ) {
+				out = before;  // t is newer than the newest sample (it hasn't arrived yet)
+			} else if ( hasAfter ) {
+				out = after;  // t is older than the ring
+			}
+			return false;
+		}
+
+		Stats stats() const
+		{
+			Stats s;
+			s.pushed  = _head.load( std::memory_order_relaxed );
+			s.drained = _drained.load( std::memory_order_relaxed );
+			s.lost    = _lost.load( std::memory_order_relaxed );
+			return s;
+		}
+
+	protected:
+		static_assert( std::is_trivially_copyable<ImuSample>::value, "samples are copied as words" );
+		static constexpr size_t kWords = ( sizeof( ImuSample ) + 7 ) / 8;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> seq{0};  // 2 * n + 2 once sample n is written, odd while writing
+			std::atomic<uint64_t> words[kWords];
+		};
+
+		std::unique_ptr<Slot[]> _slots;
+		uint64_t _mask = 0;
+		std::atomic<uint64_t> _head{0};  // samples pushed, owned by the producer
+		uint64_t _tail = 0;              // next sample to drain, owned by the consumer
+		std::atomic<uint64_t> _drained{0}, _lost{0};
+
+		// copy of sample n, false if it was overwritten (or is being written)
+		bool read( uint64_t n, ImuSample& out ) const
+		{
+			const Slot& slot        = _slots[n & _mask];
+			const uint64_t expected = 2 * n + 2;
+			if ( slot.seq.load( std::memory_order_acquire ) != expected ) return false;
+			uint64_t words[kWords];
+			for ( size_t i = 0; i < kWords; ++i ) words[i] = slot.words[i].load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if ( slot.seq.load( std::memory_order_relaxed ) != expected ) return false;  // overwritten meanwhile
+			std::memcpy( &out, words, sizeof( out ) );
+			return true;
+		}
+
+		void skipOverwritten( uint64_t head )
+		{
+			if ( head - _tail > capacity() ) {
+				_lost.fetch_add( head - capacity() - _tail, std::memory_order_relaxed );
+				_tail = head - capacity();
+			}
+		}
+
+		// first sample index with timestamp >= t, head if none
+		// unreadable (overwritten) slots are the oldest ones, so they count as < t
+		uint64_t lowerBound( double t, uint64_t head ) const
+		{
+			uint64_t lo = head > capacity() ? head - capacity() : 0, hi = head;
+			ImuSample sample;
+			while ( lo < hi ) {
+				const uint64_t mid = lo + ( hi - lo ) / 2;
+				if ( !read( mid, sample ) || sample.timestamp < t ) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ofx {
+namespace structure {
+
+	// where a frame is on its way from the sensor to the app, see FrameView::*Timestamp
+	enum class LatencyStage
+	{
+		Arrival,   // received by the SDK (usb transfer done)
+		Callback,  // handed to ofxStructureCore on the source's thread
+		Consumed,  // picked up by update()
+		Uploaded,  // its image filled (and uploaded with Settings::addon.useTextures)
+		Count
+	};
+
+	inline std::string to_string( LatencyStage stage )
+	{
+		switch ( stage ) {
+			case LatencyStage::Arrival: return "arrival";
+			case LatencyStage::Callback: return "callback";
+			case LatencyStage::Consumed: return "consumed";
+			case LatencyStage::Uploaded: return "uploaded";
+			default: return "unknown";
+		}
+	}
+
+	// in ms, percentiles are accurate to ~3% (the histogram's bucket width)
+	struct LatencyStats
+	{
+		uint64_t count = 0;
+		double mean    = 0.;
+		double p50     = 0.;
+		double p95     = 0.;
+		double p99     = 0.;
+		double max     = 0.;
+	};
+
+	// -----------------------------------------------------------------------
+	// lock-free latency histogram
+	// * log-linear buckets over microseconds: exact below 32 us, then 32 buckets per power of two
+	// * record() is a couple of relaxed atomic adds, any number of threads can record / read
+	// * stats() walks the buckets, it's a snapshot while others keep recording
+	// -----------------------------------------------------------------------
+
+	class LatencyHistogram
+	{
+	public:
+		void record( double seconds )
+		{
+			uint64_t us = seconds > 0. ? uint64_t( seconds * 1e6 + 0.5 ) : 0;  // negative / NaN (unknown timestamps) count as 0
+			us          = us < kMaxMicros ? us : kMaxMicros;
+			_buckets[bucketOf( us )].fetch_add( 1, std::memory_order_relaxed );
+			_sum.fetch_add( us, std::memory_order_relaxed );
+			uint64_t max = _max.load( std::memory_order_relaxed );
+			while ( us > max && !_max.compare_exchange_weak( max, us, std::memory_order_relaxed ) ) {
+			}
+		}
+
+		LatencyStats stats() const
+		{
+			LatencyStats s;
+			uint64_t counts[kBuckets], total = 0;
+			for ( size_t i = 0; i < kBuckets; ++i ) total += counts[i] = _buckets[i].load( std::memory_order_relaxed );
+			if ( !total ) return s;
+			const double max = double( _max.load( std::memory_order_relaxed ) );
+			s.count          = total;
+			s.mean           = double( _sum.load( std::memory_order_relaxed ) ) / total * 1e-3;
+			s.max            = max * 1e-3;
+
+			// the bucket holding the n-th smallest value, its midpoint (never above the max seen)
+			auto percentile = [&]( double p ) {
+				const uint64_t rank = uint64_t( p * ( total - 1 ) ) + 1;
+				uint64_t seen       = 0;
+				size_t i            = 0;
+				while ( i + 1 < kBuckets && ( seen += counts[i] ) < rank ) ++i;
+				const double mid = 0.5 * ( lowerBound( i ) + lowerBound( i + 1 ) - 1 );
+				return ( mid < max ? mid : max ) * 1e-3;
+			};
+			s.p50 = percentile( 0.50 );
+			s.p95 = percentile( 0.95 );
+			s.p99 = percentile( 0.99 );
+			return s;
+		}
+
+		// not atomic with concurrent record()s, a few samples may survive / get lost
+		void reset()
+		{
+			for ( auto& bucket : _buckets ) bucket.store( 0, std::memory_order_relaxed );
+			_sum.store( 0, std::memory_order_relaxed );
+			_max.store( 0, std::memory_order_relaxed );
+		}
+
+	protected:
+		static constexpr int kSubBits        = 5;  // 32 buckets per power of two
+		static constexpr uint64_t kSub       = uint64_t( 1 ) << kSubBits;
+		static constexpr uint64_t kMaxMicros = ( uint64_t( 1 ) << 31 ) - 1;  // ~36 minutes
+		static constexpr size_t kBuckets     = size_t( ( 31 - kSubBits + 1 ) * kSub );
+
+		std::atomic<uint64_t> _buckets[kBuckets] = {};
+		std::atomic<uint64_t> _sum{0}, _max{0};  // us
+
+		static size_t bucketOf( uint64_t us )
+		{
+			if ( us < kSub ) return size_t( us );
+			int msb = 0;
+			for ( uint64_t v = us; v >>= 1; ) ++msb;
+			const int shift = msb - kSubBits;
+			return size_t( ( shift + 1 ) * kSub + ( ( us >> shift ) - kSub ) );
+		}
+
+		// smallest value in bucket i
+		static double lowerBound( size_t i )
+		{
+			if ( i < kSub ) return double( i );
+			const int shift = int( i / kSub ) - 1;
+			return double( ( kSub + i % kSub ) << shift );
+		}
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,170 @@
+#include "ofxStructureCoreMesh.h"
+#include "ofxStructureCoreSimd.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+
+		// cell ( r, c ): triangle 0 = ( 00, 10, 01 ), triangle 1 = ( 01, 10, 11 )
+		inline void writeCell( ofIndexType* out, ofIndexType i00, ofIndexType width, uint8_t mask )
+		{
+			const ofIndexType i01 = i00 + 1;
+			const ofIndexType i10 = i00 + width;
+			const ofIndexType i11 = i10 + 1;
+			if ( mask & 1 ) {
+				out[0] = i00, out[1] = i10, out[2] = i01;
+			} else {
+				out[0] = out[1] = out[2] = i00;
+			}
+			if ( mask & 2 ) {
+				out[3] = i01, out[4] = i10, out[5] = i11;
+			} else {
+				out[3] = out[4] = out[5] = i01;
+			}
+		}
+
+		inline bool keep( float a, float b, float c, float maxJump )
+		{
+			return a > 0.f && b > 0.f && c > 0.f && std::max( a, std::max( b, c ) ) - std::min( a, std::min( b, c ) ) <= maxJump;
+		}
+
+		inline uint8_t cellMask( const float* top, const float* bottom, int c, float maxJump )
+		{
+			return uint8_t( keep( top[c], bottom[c], top[c + 1], maxJump ) | ( keep( top[c + 1], bottom[c], bottom[c + 1], maxJump ) << 1 ) );
+		}
+
+		// one cell row, rewrites changed cells, returns true if any changed
+		bool meshRowScalar( const float* top, const float* bottom, int cells, ofIndexType rowStart, ofIndexType width, float maxJump, uint8_t* masks, ofIndexType* out, int c = 0 )
+		{
+			bool dirty = false;
+			for ( ; c < cells; ++c ) {
+				uint8_t mask = cellMask( top, bottom, c, maxJump );
+				if ( mask == masks[c] ) continue;
+				masks[c] = mask;
+				writeCell( out + size_t( c ) * 6, rowStart + c, width, mask );
+				dirty = true;
+			}
+			return dirty;
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		// triangle bits of 4 cells ( tri0 | tri1 << 4 ) -> their 4 mask bytes
+		const uint32_t* groupMasks()
+		{
+			static const auto table = []() {
+				std::vector<uint32_t> t( 256 );
+				for ( int bits = 0; bits < 256; ++bits ) {
+					uint8_t group[4];
+					for ( int k = 0; k < 4; ++k ) group[k] = uint8_t( ( ( bits >> k ) & 1 ) | ( ( ( bits >> ( k + 4 ) ) & 1 ) << 1 ) );
+					std::memcpy( &t[bits], group, 4 );
+				}
+				return t;
+			}();
+			return table.data();
+		}
+
+		inline __m128 keep4( __m128 a, __m128 b, __m128 c, __m128 maxJump )
+		{
+			const __m128 zero  = _mm_setzero_ps();
+			const __m128 valid = _mm_and_ps( _mm_and_ps( _mm_cmpgt_ps( a, zero ), _mm_cmpgt_ps( b, zero ) ), _mm_cmpgt_ps( c, zero ) );
+			const __m128 range = _mm_sub_ps( _mm_max_ps( a, _mm_max_ps( b, c ) ), _mm_min_ps( a, _mm_min_ps( b, c ) ) );
+			return _mm_and_ps( valid, _mm_cmple_ps( range, maxJump ) );
+		}
+
+		// 4 cells at a time, unchanged groups (most of them) cost a compare
+		bool meshRowSSE2( const float* top, const float* bottom, int cells, ofIndexType rowStart, ofIndexType width, float maxJump, uint8_t* masks, ofIndexType* out )
+		{
+			const __m128 jump = _mm_set1_ps( maxJump );
+			bool dirty        = false;
+			int c             = 0;
+			for ( ; c + 4 <= cells; c += 4 ) {
+				const __m128 t0 = _mm_loadu_ps( top + c );
+				const __m128 t1 = _mm_loadu_ps( top + c + 1 );
+				const __m128 b0 = _mm_loadu_ps( bottom + c );
+				const __m128 b1 = _mm_loadu_ps( bottom + c + 1 );
+				const int tri0  = _mm_movemask_ps( keep4( t0, b0, t1, jump ) );
+				const int tri1  = _mm_movemask_ps( keep4( t1, b0, b1, jump ) );
+
+				uint8_t group[4];
+				std::memcpy( group, &groupMasks()[tri0 | ( tri1 << 4 )], 4 );
+				if ( std::memcmp( group, masks + c, 4 ) == 0 ) continue;
+				for ( int k = 0; k < 4; ++k ) {
+					if ( group[k] == masks[c + k] ) continue;
+					masks[c + k] = group[k];
+					writeCell( out + size_t( c + k ) * 6, rowStart + c + k, width, group[k] );
+				}
+				dirty = true;
+			}
+			return meshRowScalar( top, bottom, cells, rowStart, width, maxJump, masks, out, c ) || dirty;
+		}
+#endif
+
+		bool meshRow( const float* top, const float* bottom, int cells, ofIndexType rowStart, ofIndexType width, float maxJump, uint8_t* masks, ofIndexType* out )
+		{
+			switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+				case SimdLevel::AVX2:
+				case SimdLevel::SSE2: return meshRowSSE2( top, bottom, cells, rowStart, width, maxJump, masks, out );
+#endif
+				default: return meshRowScalar( top, bottom, cells, rowStart, width, maxJump, masks, out );
+			}
+		}
+
+	}  // namespace
+
+	bool GridMesher::update( const float* depths, int width, int height, float maxDepthJump, ThreadPool& pool )
+	{
+		_dirtyRows.clear();
+		_resized = width != _width || height != _height;
+		if ( _resized ) {
+			_width          = width;
+			_height         = height;
+			const int cells = width > 1 && height > 1 ? ( width - 1 ) * ( height - 1 ) : 0;
+			_indices.resize( size_t( cells ) * 6 );
+			_masks.assign( cells, 0xFF );  // not a real mask, so every cell gets written
+			_rowDirty.resize( std::max( height - 1, 0 ) );
+		}
+		if ( _indices.empty() ) return _resized;
+
+		const int cellRows  = _height - 1;
+		const int cellCols  = _width - 1;
+		const size_t perRow = indicesPerRow();
+		pool.parallelFor( 0, cellRows, 8, [&]( size_t b, size_t e ) {
+			for ( size_t r = b; r < e; ++r ) {
+				const float* top = depths + r * _width;
+				_rowDirty[r]     = meshRow( top, top + _width, cellCols, ofIndexType( r * _width ), ofIndexType( _width ), maxDepthJump, &_masks[r * cellCols], &_indices[r * perRow] );
+			}
+		} );
+
+		// merge into runs for partial uploads
+		for ( int r = 0; r < cellRows; ++r ) {
+			if ( !_rowDirty[r] ) continue;
+			if ( !_dirtyRows.empty() && _dirtyRows.back().second == r ) {
+				_dirtyRows.back().second = r + 1;
+			} else {
+				_dirtyRows.emplace_back( r, r + 1 );
+			}
+		}
+		return _resized || !_dirtyRows.empty();
+	}
+
+	void GridMesher::clear()
+	{
+		_width = _height = 0;
+		_indices.clear();
+		_masks.clear();
+		_rowDirty.clear();
+		_dirtyRows.clear();
+		_resized = false;
+	}
+
+}  // namespace structure
+}  // namespace ofx
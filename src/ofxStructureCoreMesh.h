@@ -0,0 +1,42 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxStructureCoreThreadPool.h"
+#include <utility>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// triangle mesh over the organized depth grid
+	// * each cell of 2x2 pixels has 2 triangles at a fixed place in the index buffer (6 indices)
+	// * a triangle is kept if its 3 depths are valid and within maxDepthJump of each other,
+	//   dropped ones are degenerate (all 3 indices the same), which the gpu skips
+	// * only cells whose triangles changed since the last update are rewritten
+	// -----------------------------------------------------------------------
+
+	class GridMesher
+	{
+	public:
+		// returns true if any index changed
+		bool update( const float* depths, int width, int height, float maxDepthJump, ThreadPool& pool );
+		void clear();
+
+		const std::vector<ofIndexType>& indices() const { return _indices; }
+		size_t indicesPerRow() const { return _width > 1 ? size_t( _width - 1 ) * 6 : 0; }
+
+		// after update(): true if all indices were rebuilt (new dims), else the changed cell rows
+		bool resized() const { return _resized; }
+		const std::vector<std::pair<int, int>>& dirtyRows() const { return _dirtyRows; }  // [begin, end) runs
+
+	protected:
+		int _width = 0, _height = 0;
+		std::vector<ofIndexType> _indices;
+		std::vector<uint8_t> _masks;     // per cell, bit 0 / 1 = triangle kept
+		std::vector<uint8_t> _rowDirty;  // per cell row
+		std::vector<std::pair<int, int>> _dirtyRows;
+		bool _resized = false;
+	};
+
+}  // namespace structure
+}  // namespace ofx
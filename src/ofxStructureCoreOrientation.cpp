@@ -0,0 +1,94 @@
+#include "ofxStructureCoreOrientation.h"
+#include <cmath>
+
+namespace ofx {
+namespace structure {
+
+	void OrientationFilter::add( const ImuSample& sample )
+	{
+		if ( !params.enabled ) return;
+		if ( _resetRequested.exchange( false, std::memory_order_relaxed ) ) {
+			_hasAccel = _hasGyro = false;
+			_samples             = 0;
+		}
+
+		if ( sample.type == ImuSample::Type::Accelerometer ) {
+			const double n = std::sqrt( sample.x * sample.x + sample.y * sample.y + sample.z * sample.z );
+			if ( !( n > 1e-6 ) ) return;  // free fall / no reading, nothing to correct with
+			_accel[0] = sample.x / n, _accel[1] = sample.y / n, _accel[2] = sample.z / n;
+			const bool first = !_hasAccel;
+			_hasAccel        = true;
+			if ( first || !_hasGyro ) {
+				initFromAccel();  // start aligned with gravity, or tilt only while there's no gyro
+				publish( sample.timestamp );
+			}
+			return;
+		}
+
+		const double dt = sample.timestamp - _lastGyroT;
+		const bool gap  = !_hasGyro || !( dt > 0. ) || dt > params.maxGap;
+		_hasGyro        = true;
+		_lastGyroT      = sample.timestamp;
+		if ( !_hasAccel || gap ) return;  // nothing to integrate from yet
+		integrate( sample, dt );
+		publish( sample.timestamp );
+	}
+
+	void OrientationFilter::initFromAccel()
+	{
+		// the rotation with no heading that takes world z to the accelerometer direction a:
+		// gravity( q ) = ( 2( xz - wy ), 2( wx + yz ), w^2 - x^2 - y^2 + z^2 ) = a with z = 0
+		const double ax = _accel[0], ay = _accel[1], az = _accel[2];
+		if ( az < -0.9999 ) {
+			_q[0] = 0., _q[1] = 1., _q[2] = 0., _q[3] = 0.;  // upside down, half turn around x
+			return;
+		}
+		const double w = std::sqrt( 0.5 * ( 1. + az ) );
+		_q[0] = w, _q[1] = ay / ( 2. * w ), _q[2] = -ax / ( 2. * w ), _q[3] = 0.;
+	}
+
+	void OrientationFilter::integrate( const ImuSample& gyro, double dt )
+	{
+		double q0 = _q[0], q1 = _q[1], q2 = _q[2], q3 = _q[3];
+		const double gx = gyro.x, gy = gyro.y, gz = gyro.z;
+		const double ax = _accel[0], ay = _accel[1], az = _accel[2];
+
+		// rate of change from the gyro: 0.5 * q * ( 0, g )
+		double qDot0 = 0.5 * ( -q1 * gx - q2 * gy - q3 * gz );
+		double qDot1 = 0.5 * ( q0 * gx + q2 * gz - q3 * gy );
+		double qDot2 = 0.5 * ( q0 * gy - q1 * gz + q3 * gx );
+		double qDot3 = 0.5 * ( q0 * gz + q1 * gy - q2 * gx );
+
+		// gradient descent step towards the accelerometer direction
+		const double _2q0 = 2. * q0, _2q1 = 2. * q1, _2q2 = 2. * q2, _2q3 = 2. * q3;
+		const double _4q0 = 4. * q0, _4q1 = 4. * q1, _4q2 = 4. * q2;
+		const double _8q1 = 8. * q1, _8q2 = 8. * q2;
+		const double q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+		double s0         = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		double s1         = _4q1 * q3q3 - _2q3 * ax + 4. * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		double s2         = 4. * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		double s3         = 4. * q1q1 * q3 - _2q1 * ax + 4. * q2q2 * q3 - _2q2 * ay;
+		const double sn   = std::sqrt( s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3 );
+		if ( sn > 1e-12 ) {
+			const double beta = params.beta / sn;
+			qDot0 -= beta * s0, qDot1 -= beta * s1, qDot2 -= beta * s2, qDot3 -= beta * s3;
+		}
+
+		q0 += qDot0 * dt, q1 += qDot1 * dt, q2 += qDot2 * dt, q3 += qDot3 * dt;
+		const double n = 1. / std::sqrt( q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3 );
+		_q[0] = q0 * n, _q[1] = q1 * n, _q[2] = q2 * n, _q[3] = q3 * n;
+	}
+
+	void OrientationFilter::publish( double timestamp )
+	{
+		const double w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+		Orientation& o = _snapshot.back();
+		o.rotation     = glm::quat( float( w ), float( x ), float( y ), float( z ) );
+		o.gravity      = glm::vec3( float( 2. * ( x * z - w * y ) ), float( 2. * ( w * x + y * z ) ), float( w * w - x * x - y * y + z * z ) );
+		o.timestamp    = timestamp;
+		o.samples      = ++_samples;
+		_snapshot.publish();
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,73 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxStructureCoreFrames.h"
+#include "ofxStructureCoreTripleBuffer.h"
+#include <atomic>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// imu orientation fusion (madgwick, accelerometer + gyroscope), see Settings::addon.orientation
+	// * runs on the source's imu thread for every sample, not at app frame rate
+	// * gyro samples integrate the rotation rate, corrected towards the latest accelerometer sample
+	// * without gyro samples the estimate is tilt only, straight from the accelerometer
+	// * no magnetometer: heading starts at 0 and drifts slowly
+	// -----------------------------------------------------------------------
+
+	struct OrientationFilterParams
+	{
+		bool enabled  = true;
+		float beta    = 0.05f;  // gain of the accelerometer correction, higher converges faster but lets more linear acceleration in
+		double maxGap = 0.1;    // s, gyro gaps longer than this aren't integrated (dropped samples, restarts)
+	};
+
+	struct Orientation
+	{
+		glm::quat rotation = glm::quat( 1.f, 0.f, 0.f, 0.f );  // sensor -> world, world z is the direction the accelerometer reads at rest
+		glm::vec3 gravity  = glm::vec3( 0.f );                 // world z in sensor coordinates, unit length (the filtered accelerometer direction)
+		double timestamp   = 0.;                               // of the last sample fused
+		uint64_t samples   = 0;                                // fused so far, 0 = no estimate yet
+	};
+
+	// -----------------------------------------------------------------------
+
+	class OrientationFilter
+	{
+	public:
+		// read on the imu thread, set before streaming starts
+		OrientationFilterParams params;
+
+		// imu thread: fuse one sample and publish the new estimate
+		void add( const ImuSample& sample );
+
+		// any thread: the imu thread starts over from the next accelerometer sample
+		void reset() { _resetRequested.store( true, std::memory_order_relaxed ); }
+
+		// latest estimate, wait-free (call from one reader thread, e.g. the app / render thread)
+		const Orientation& get()
+		{
+			_snapshot.consume();
+			return _snapshot.front();
+		}
+
+	protected:
+		// owned by the imu thread
+		double _q[4]           = {1., 0., 0., 0.};  // w, x, y, z
+		double _accel[3]       = {0., 0., 0.};      // latest accelerometer direction, unit length
+		bool _hasAccel         = false;
+		bool _hasGyro          = false;
+		double _lastGyroT      = 0.;
+		uint64_t _samples      = 0;
+		std::atomic<bool> _resetRequested{false};
+
+		TripleBuffer<Orientation> _snapshot;
+
+		void initFromAccel();
+		void integrate( const ImuSample& gyro, double dt );
+		void publish( double timestamp );
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,546 @@
+#include "ofxStructureCorePointCloud.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( _M_ARM64 )
+#define OFX_STRUCTURE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define OFX_STRUCTURE_TARGET( t ) __attribute__( ( target( t ) ) )
+#else
+#define OFX_STRUCTURE_TARGET( t )  // msvc: intrinsics don't need a target flag
+#endif
+
+namespace ofx {
+namespace structure {
+
+	static_assert( sizeof( glm::vec3 ) == 3 * sizeof( float ), "kernels write glm::vec3 as packed xyz floats" );
+
+	// the vector kernels do the same single multiply per axis as the scalar loop and flip the sign bit
+
+	namespace {
+
+		// normal of pixel ( r, c ), the vector kernels do the same ops in the same order
+		inline glm::vec3 normalAt( const float* depths, const RayTable& rays, int r, int c )
+		{
+			const int cols  = rays.width();
+			const int rows  = rays.height();
+			const float* rx = rays.x();
+			const float* ry = rays.y();
+			const float* d  = depths + size_t( r ) * cols;
+
+			const float dc = d[c];
+			if ( !( dc > 0.f ) ) return glm::vec3( 0.f );
+			auto point = [&]( int pr, int pc, float depth ) { return glm::vec3( -( depth * rx[pc] ), -( depth * ry[pr] ), depth ); };
+			const glm::vec3 p = point( r, c, dc );
+
+			// invalid neighbours fall back to the center
+			const float dl    = c > 0 ? d[c - 1] : 0.f;
+			const float dr    = c + 1 < cols ? d[c + 1] : 0.f;
+			const float du    = r > 0 ? d[c - cols] : 0.f;
+			const float dd    = r + 1 < rows ? d[c + cols] : 0.f;
+			const glm::vec3 l = dl > 0.f ? point( r, c - 1, dl ) : p;
+			const glm::vec3 R = dr > 0.f ? point( r, c + 1, dr ) : p;
+			const glm::vec3 u = du > 0.f ? point( r - 1, c, du ) : p;
+			const glm::vec3 D = dd > 0.f ? point( r + 1, c, dd ) : p;
+
+			const glm::vec3 tx = R - l;
+			const glm::vec3 ty = D - u;
+			glm::vec3 n( tx.y * ty.z - tx.z * ty.y, tx.z * ty.x - tx.x * ty.z, tx.x * ty.y - tx.y * ty.x );
+			const float len2 = n.x * n.x + n.y * n.y + n.z * n.z;
+			if ( !( len2 > 0.f ) ) return glm::vec3( 0.f );
+			const float len = std::sqrt( len2 );
+			n               = glm::vec3( n.x / len, n.y / len, n.z / len );
+			return n.x * p.x + n.y * p.y + n.z * p.z > 0.f ? -n : n;  // face the sensor (at the origin)
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		// interleave 4 x, 4 y, 4 z into 12 xyz floats
+		inline void storeXYZ( float* out, __m128 x, __m128 y, __m128 z )
+		{
+			__m128 xy01 = _mm_unpacklo_ps( x, y );                            // x0 y0 x1 y1
+			__m128 xy23 = _mm_unpackhi_ps( x, y );                            // x2 y2 x3 y3
+			__m128 z0x1 = _mm_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) );  // z0 z0 x1 x1
+			__m128 y1z1 = _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) );  // y1 y1 z1 z1
+			__m128 z2x3 = _mm_shuffle_ps( z, x, _MM_SHUFFLE( 3, 3, 2, 2 ) );  // z2 z2 x3 x3
+			__m128 y3z3 = _mm_shuffle_ps( y, z, _MM_SHUFFLE( 3, 3, 3, 3 ) );  // y3 y3 z3 z3
+			_mm_storeu_ps( out + 0, _mm_shuffle_ps( xy01, z0x1, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );  // x0 y0 z0 x1
+			_mm_storeu_ps( out + 4, _mm_shuffle_ps( y1z1, xy23, _MM_SHUFFLE( 1, 0, 2, 0 ) ) );  // y1 z1 x2 y2
+			_mm_storeu_ps( out + 8, _mm_shuffle_ps( z2x3, y3z3, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );  // z2 x3 y3 z3
+		}
+
+		void depthToPointsSSE2( const float* depths, const RayTable& rays, glm::vec3* points, int rowBegin, int rowEnd )
+		{
+			const int cols    = rays.width();
+			const __m128 sign = _mm_set1_ps( -0.f );
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				const float* d  = depths + size_t( r ) * cols;
+				const float* rx = rays.x();
+				float* out      = &points[size_t( r ) * cols].x;
+				const float ry  = rays.y()[r];
+				const __m128 y4 = _mm_set1_ps( ry );
+				int c           = 0;
+				for ( ; c + 4 <= cols; c += 4, out += 12 ) {
+					__m128 depth = _mm_loadu_ps( d + c );
+					__m128 x     = _mm_xor_ps( _mm_mul_ps( depth, _mm_loadu_ps( rx + c ) ), sign );
+					__m128 y     = _mm_xor_ps( _mm_mul_ps( depth, y4 ), sign );
+					storeXYZ( out, x, y, depth );
+				}
+				for ( ; c < cols; ++c, out += 3 ) {
+					float depth = d[c];
+					out[0]      = -( depth * rx[c] );
+					out[1]      = -( depth * ry );
+					out[2]      = depth;
+				}
+			}
+		}
+
+		OFX_STRUCTURE_TARGET( "avx2" )
+		void depthToPointsAVX2( const float* depths, const RayTable& rays, glm::vec3* points, int rowBegin, int rowEnd )
+		{
+			const int cols    = rays.width();
+			const __m256 sign = _mm256_set1_ps( -0.f );
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				const float* d  = depths + size_t( r ) * cols;
+				const float* rx = rays.x();
+				float* out      = &points[size_t( r ) * cols].x;
+				const float ry  = rays.y()[r];
+				const __m256 y8 = _mm256_set1_ps( ry );
+				int c           = 0;
+				for ( ; c + 8 <= cols; c += 8, out += 24 ) {
+					__m256 depth = _mm256_loadu_ps( d + c );
+					__m256 x     = _mm256_xor_ps( _mm256_mul_ps( depth, _mm256_loadu_ps( rx + c ) ), sign );
+					__m256 y     = _mm256_xor_ps( _mm256_mul_ps( depth, y8 ), sign );
+					storeXYZ( out, _mm256_castps256_ps128( x ), _mm256_castps256_ps128( y ), _mm256_castps256_ps128( depth ) );
+					storeXYZ( out + 12, _mm256_extractf128_ps( x, 1 ), _mm256_extractf128_ps( y, 1 ), _mm256_extractf128_ps( depth, 1 ) );
+				}
+				for ( ; c < cols; ++c, out += 3 ) {
+					float depth = d[c];
+					out[0]      = -( depth * rx[c] );
+					out[1]      = -( depth * ry );
+					out[2]      = depth;
+				}
+			}
+		}
+
+		// 16 bit millimeters, widened 8 at a time (exact), then the same ops as the float kernel
+		void depthToPointsSSE2( const uint16_t* depths, const RayTable& rays, glm::vec3* points, int rowBegin, int rowEnd )
+		{
+			const int cols     = rays.width();
+			const __m128 sign  = _mm_set1_ps( -0.f );
+			const __m128i zero = _mm_setzero_si128();
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				const uint16_t* d = depths + size_t( r ) * cols;
+				const float* rx   = rays.x();
+				float* out        = &points[size_t( r ) * cols].x;
+				const float ry    = rays.y()[r];
+				const __m128 y4   = _mm_set1_ps( ry );
+				int c             = 0;
+				for ( ; c + 8 <= cols; c += 8, out += 24 ) {
+					const __m128i mm    = _mm_loadu_si128( ( const __m128i* )( d + c ) );
+					const __m128 depth0 = _mm_cvtepi32_ps( _mm_unpacklo_epi16( mm, zero ) );
+					const __m128 depth1 = _mm_cvtepi32_ps( _mm_unpackhi_epi16( mm, zero ) );
+					storeXYZ( out, _mm_xor_ps( _mm_mul_ps( depth0, _mm_loadu_ps( rx + c ) ), sign ), _mm_xor_ps( _mm_mul_ps( depth0, y4 ), sign ), depth0 );
+					storeXYZ( out + 12, _mm_xor_ps( _mm_mul_ps( depth1, _mm_loadu_ps( rx + c + 4 ) ), sign ), _mm_xor_ps( _mm_mul_ps( depth1, y4 ), sign ), depth1 );
+				}
+				for ( ; c < cols; ++c, out += 3 ) {
+					float depth = float( d[c] );
+					out[0]      = -( depth * rx[c] );
+					out[1]      = -( depth * ry );
+					out[2]      = depth;
+				}
+			}
+		}
+#endif
+
+#ifdef OFX_STRUCTURE_X64
+		// 4 columns at a time, in registers as x / y / z
+		struct Vec4x3
+		{
+			__m128 x, y, z;
+		};
+
+		inline __m128 select( __m128 mask, __m128 a, __m128 b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+		inline Vec4x3 select( __m128 mask, const Vec4x3& a, const Vec4x3& b ) { return {select( mask, a.x, b.x ), select( mask, a.y, b.y ), select( mask, a.z, b.z )}; }
+		inline Vec4x3 sub( const Vec4x3& a, const Vec4x3& b ) { return {_mm_sub_ps( a.x, b.x ), _mm_sub_ps( a.y, b.y ), _mm_sub_ps( a.z, b.z )}; }
+		inline Vec4x3 point4( __m128 depth, __m128 rx, __m128 ry )
+		{
+			const __m128 sign = _mm_set1_ps( -0.f );
+			return {_mm_xor_ps( _mm_mul_ps( depth, rx ), sign ), _mm_xor_ps( _mm_mul_ps( depth, ry ), sign ), depth};
+		}
+
+		void depthToNormalsSSE2( const float* depths, const RayTable& rays, glm::vec3* normals, int rowBegin, int rowEnd )
+		{
+			const int cols    = rays.width();
+			const int rows    = rays.height();
+			const float* rx   = rays.x();
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 sign = _mm_set1_ps( -0.f );
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				if ( r == 0 || r + 1 == rows || cols < 3 ) {
+					for ( int c = 0; c < cols; ++c ) normals[size_t( r ) * cols + c] = normalAt( depths, rays, r, c );
+					continue;
+				}
+				const float* d   = depths + size_t( r ) * cols;
+				float* out       = &normals[size_t( r ) * cols].x;
+				const __m128 ryC = _mm_set1_ps( rays.y()[r] );
+				const __m128 ryU = _mm_set1_ps( rays.y()[r - 1] );
+				const __m128 ryD = _mm_set1_ps( rays.y()[r + 1] );
+
+				normals[size_t( r ) * cols] = normalAt( depths, rays, r, 0 );
+				int c                       = 1;
+				for ( ; c + 4 < cols; c += 4 ) {
+					const __m128 dc  = _mm_loadu_ps( d + c );
+					const __m128 dl  = _mm_loadu_ps( d + c - 1 );
+					const __m128 dr  = _mm_loadu_ps( d + c + 1 );
+					const __m128 du  = _mm_loadu_ps( d + c - cols );
+					const __m128 dd  = _mm_loadu_ps( d + c + cols );
+					const __m128 rxC = _mm_loadu_ps( rx + c );
+
+					const Vec4x3 p = point4( dc, rxC, ryC );
+					const Vec4x3 l = select( _mm_cmpgt_ps( dl, zero ), point4( dl, _mm_loadu_ps( rx + c - 1 ), ryC ), p );
+					const Vec4x3 R = select( _mm_cmpgt_ps( dr, zero ), point4( dr, _mm_loadu_ps( rx + c + 1 ), ryC ), p );
+					const Vec4x3 u = select( _mm_cmpgt_ps( du, zero ), point4( du, rxC, ryU ), p );
+					const Vec4x3 D = select( _mm_cmpgt_ps( dd, zero ), point4( dd, rxC, ryD ), p );
+
+					const Vec4x3 tx = sub( R, l );
+					const Vec4x3 ty = sub( D, u );
+					Vec4x3 n        = {_mm_sub_ps( _mm_mul_ps( tx.y, ty.z ), _mm_mul_ps( tx.z, ty.y ) ),
+                                _mm_sub_ps( _mm_mul_ps( tx.z, ty.x ), _mm_mul_ps( tx.x, ty.z ) ),
+                                _mm_sub_ps( _mm_mul_ps( tx.x, ty.y ), _mm_mul_ps( tx.y, ty.x ) )};
+					const __m128 len2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( n.x, n.x ), _mm_mul_ps( n.y, n.y ) ), _mm_mul_ps( n.z, n.z ) );
+					const __m128 len  = _mm_sqrt_ps( len2 );
+					n                 = {_mm_div_ps( n.x, len ), _mm_div_ps( n.y, len ), _mm_div_ps( n.z, len )};
+
+					// face the sensor, then zero where undefined
+					const __m128 dot  = _mm_add_ps( _mm_add_ps( _mm_mul_ps( n.x, p.x ), _mm_mul_ps( n.y, p.y ) ), _mm_mul_ps( n.z, p.z ) );
+					const __m128 flip = _mm_and_ps( _mm_cmpgt_ps( dot, zero ), sign );
+					const __m128 ok   = _mm_and_ps( _mm_cmpgt_ps( dc, zero ), _mm_cmpgt_ps( len2, zero ) );
+					storeXYZ( out + c * 3, _mm_and_ps( _mm_xor_ps( n.x, flip ), ok ), _mm_and_ps( _mm_xor_ps( n.y, flip ), ok ), _mm_and_ps( _mm_xor_ps( n.z, flip ), ok ) );
+				}
+				for ( ; c < cols; ++c ) normals[size_t( r ) * cols + c] = normalAt( depths, rays, r, c );
+			}
+		}
+#endif
+
+#ifdef OFX_STRUCTURE_NEON
+		void depthToPointsNEON( const float* depths, const RayTable& rays, glm::vec3* points, int rowBegin, int rowEnd )
+		{
+			const int cols = rays.width();
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				const float* d       = depths + size_t( r ) * cols;
+				const float* rx      = rays.x();
+				float* out           = &points[size_t( r ) * cols].x;
+				const float ry       = rays.y()[r];
+				const float32x4_t y4 = vdupq_n_f32( ry );
+				int c                = 0;
+				for ( ; c + 4 <= cols; c += 4, out += 12 ) {
+					float32x4x3_t xyz;
+					xyz.val[2] = vld1q_f32( d + c );
+					xyz.val[0] = vnegq_f32( vmulq_f32( xyz.val[2], vld1q_f32( rx + c ) ) );
+					xyz.val[1] = vnegq_f32( vmulq_f32( xyz.val[2], y4 ) );
+					vst3q_f32( out, xyz );  // interleaved store
+				}
+				for ( ; c < cols; ++c, out += 3 ) {
+					float depth = d[c];
+					out[0]      = -( depth * rx[c] );
+					out[1]      = -( depth * ry );
+					out[2]      = depth;
+				}
+			}
+		}
+
+		void depthToPointsNEON( const uint16_t* depths, const RayTable& rays, glm::vec3* points, int rowBegin, int rowEnd )
+		{
+			const int cols = rays.width();
+			for ( int r = rowBegin; r < rowEnd; ++r ) {
+				const uint16_t* d    = depths + size_t( r ) * cols;
+				const float* rx      = rays.x();
+				float* out           = &points[size_t( r ) * cols].x;
+				const float ry       = rays.y()[r];
+				const float32x4_t y4 = vdupq_n_f32( ry );
+				int c                = 0;
+				for ( ; c + 4 <= cols; c += 4, out += 12 ) {
+					float32x4x3_t xyz;
+					xyz.val[2] = vcvtq_f32_u32( vmovl_u16( vld1_u16( d + c ) ) );  // exact widen
+					xyz.val[0] = vnegq_f32( vmulq_f32( xyz.val[2], vld1q_f32( rx + c ) ) );
+					xyz.val[1] = vnegq_f32( vmulq_f32( xyz.val[2], y4 ) );
+					vst3q_f32( out, xyz );
+				}
+				for ( ; c < cols; ++c, out += 3 ) {
+					float depth = float( d[c] );
+					out[0]      = -( depth * rx[c] );
+					out[1]      = -( depth * ry );
+					out[2]      = depth;
+				}
+			}
+		}
+#endif
+
+		// valid = depth > 0
+
+		size_t countValidScalar( const float* d, int n )
+		{
+			size_t count = 0;
+			for ( int i = 0; i < n; ++i ) count += d[i] > 0.f;
+			return count;
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		size_t countValidSSE2( const float* d, int n )
+		{
+			const __m128 zero = _mm_setzero_ps();
+			__m128i acc       = _mm_setzero_si128();
+			int i             = 0;
+			for ( ; i + 4 <= n; i += 4 ) {
+				acc = _mm_sub_epi32( acc, _mm_castps_si128( _mm_cmpgt_ps( _mm_loadu_ps( d + i ), zero ) ) );  // true = -1
+			}
+			uint32_t lanes[4];
+			_mm_storeu_si128( ( __m128i* )lanes, acc );
+			return size_t( lanes[0] ) + lanes[1] + lanes[2] + lanes[3] + countValidScalar( d + i, n - i );
+		}
+#endif
+
+#ifdef OFX_STRUCTURE_NEON
+		size_t countValidNEON( const float* d, int n )
+		{
+			const float32x4_t zero = vdupq_n_f32( 0.f );
+			uint32x4_t acc         = vdupq_n_u32( 0 );
+			int i                  = 0;
+			for ( ; i + 4 <= n; i += 4 ) {
+				acc = vsubq_u32( acc, vcgtq_f32( vld1q_f32( d + i ), zero ) );  // true = all bits set
+			}
+			return size_t( vgetq_lane_u32( acc, 0 ) ) + vgetq_lane_u32( acc, 1 ) + vgetq_lane_u32( acc, 2 ) + vgetq_lane_u32( acc, 3 ) + countValidScalar( d + i, n - i );
+		}
+#endif
+
+		size_t countValid( const float* d, int n )
+		{
+			switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+				case SimdLevel::AVX2:
+				case SimdLevel::SSE2: return countValidSSE2( d, n );  // memory bound, sse2 is enough
+#endif
+#ifdef OFX_STRUCTURE_NEON
+				case SimdLevel::NEON: return countValidNEON( d, n );
+#endif
+				default: return countValidScalar( d, n );
+			}
+		}
+
+		// one row of valid points into slots [o, last), returns the next free slot
+
+		size_t compactRowScalar( const float* d, const float* rx, float ry, uint32_t row, int cols, glm::vec3* points, uint32_t* indices, size_t o )
+		{
+			for ( int c = 0; c < cols; ++c ) {
+				float depth = d[c];
+				if ( !( depth > 0.f ) ) continue;
+				points[o].x  = -( depth * rx[c] );  // same ops as depthToPointsScalar
+				points[o].y  = -( depth * ry );
+				points[o].z  = depth;
+				indices[o++] = row + c;
+			}
+			return o;
+		}
+
+		// runs of 4 fully valid / invalid pixels are the common case (holes are blobs, not noise)
+
+#ifdef OFX_STRUCTURE_X64
+		size_t compactRowSSE2( const float* d, const float* rx, float ry, uint32_t row, int cols, glm::vec3* points, uint32_t* indices, size_t o, size_t last )
+		{
+			const __m128 sign  = _mm_set1_ps( -0.f );
+			const __m128 zero  = _mm_setzero_ps();
+			const __m128 y4    = _mm_set1_ps( ry );
+			const __m128i lane = _mm_setr_epi32( 0, 1, 2, 3 );
+			int c              = 0;
+			for ( ; c + 4 <= cols; c += 4 ) {
+				__m128 depth = _mm_loadu_ps( d + c );
+				int mask     = _mm_movemask_ps( _mm_cmpgt_ps( depth, zero ) );
+				if ( mask == 0 ) continue;
+				__m128 x = _mm_xor_ps( _mm_mul_ps( depth, _mm_loadu_ps( rx + c ) ), sign );
+				__m128 y = _mm_xor_ps( _mm_mul_ps( depth, y4 ), sign );
+				if ( mask == 0xF ) {
+					storeXYZ( &points[o].x, x, y, depth );
+					_mm_storeu_si128( ( __m128i* )( indices + o ), _mm_add_epi32( _mm_set1_epi32( int( row + c ) ), lane ) );
+					o += 4;
+					continue;
+				}
+				// mixed: write all 4 to consecutive slots, advancing only past valid ones
+				// at least one is valid, so the 4 slots from o on are ours only while o + 3 < last
+				if ( o + 3 >= last ) {
+					o = compactRowScalar( d + c, rx + c, ry, row + c, 4, points, indices, o );
+					continue;
+				}
+				alignas( 16 ) float xyz[12];
+				storeXYZ( xyz, x, y, depth );
+				for ( int i = 0; i < 4; ++i ) {
+					std::memcpy( &points[o], xyz + i * 3, sizeof( glm::vec3 ) );
+					indices[o] = row + c + i;
+					o += ( mask >> i ) & 1;
+				}
+			}
+			return compactRowScalar( d + c, rx + c, ry, row + c, cols - c, points, indices, o );
+		}
+#endif
+
+#ifdef OFX_STRUCTURE_NEON
+		size_t compactRowNEON( const float* d, const float* rx, float ry, uint32_t row, int cols, glm::vec3* points, uint32_t* indices, size_t o, size_t last )
+		{
+			const float32x4_t zero = vdupq_n_f32( 0.f );
+			const float32x4_t y4   = vdupq_n_f32( ry );
+			const uint32_t laneInit[4] = {0, 1, 2, 3};
+			const uint32x4_t lane  = vld1q_u32( laneInit );
+			int c                  = 0;
+			for ( ; c + 4 <= cols; c += 4 ) {
+				float32x4_t depth = vld1q_f32( d + c );
+				uint32x4_t valid  = vcgtq_f32( depth, zero );
+				if ( vmaxvq_u32( valid ) == 0 ) continue;
+				float32x4x3_t xyz;
+				xyz.val[2] = depth;
+				xyz.val[0] = vnegq_f32( vmulq_f32( depth, vld1q_f32( rx + c ) ) );
+				xyz.val[1] = vnegq_f32( vmulq_f32( depth, y4 ) );
+				if ( vminvq_u32( valid ) != 0 ) {
+					vst3q_f32( &points[o].x, xyz );
+					vst1q_u32( indices + o, vaddq_u32( vdupq_n_u32( row + c ), lane ) );
+					o += 4;
+					continue;
+				}
+				// mixed, see compactRowSSE2()
+				if ( o + 3 >= last ) {
+					o = compactRowScalar( d + c, rx + c, ry, row + c, 4, points, indices, o );
+					continue;
+				}
+				float tmp[12];
+				uint32_t flags[4];
+				vst3q_f32( tmp, xyz );
+				vst1q_u32( flags, valid );
+				for ( int i = 0; i < 4; ++i ) {
+					std::memcpy( &points[o], tmp + i * 3, sizeof( glm::vec3 ) );
+					indices[o] = row + c + i;
+					o += flags[i] & 1;
+				}
+			}
+			return compactRowScalar( d + c, rx + c, ry, row + c, cols - c, points, indices, o );
+		}
+#endif
+
+		size_t compactRow( const float* d, const float* rx, float ry, uint32_t row, int cols, glm::vec3* points, uint32_t* indices, size_t o, size_t last )
+		{
+			switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+				case SimdLevel::AVX2:
+				case SimdLevel::SSE2: return compactRowSSE2( d, rx, ry, row, cols, points, indices, o, last );
+#endif
+#ifdef OFX_STRUCTURE_NEON
+				case SimdLevel::NEON: return compactRowNEON( d, rx, ry, row, cols, points, indices, o, last );
+#endif
+				default: ( void )last; return compactRowScalar( d, rx, ry, row, cols, points, indices, o );
+			}
+		}
+
+	}  // namespace
+
+	// -----------------------------------------------------------------------
+
+	size_t PointCompactor::count( const float* depths, const RayTable& rays, ThreadPool& pool )
+	{
+		const int cols    = rays.width();
+		const int rows    = rays.height();
+		const size_t nBlk = ( rows + blockRows - 1 ) / blockRows;
+		_offsets.resize( nBlk + 1 );
+
+		// block counts go one slot up, so the scan below leaves exclusive offsets
+		_offsets[0] = 0;
+		pool.parallelFor( 0, nBlk, 1, [&]( size_t b, size_t e ) {
+			for ( size_t blk = b; blk < e; ++blk ) {
+				const int r0 = int( blk ) * blockRows;
+				const int r1 = std::min( r0 + blockRows, rows );
+				_offsets[blk + 1] = countValid( depths + size_t( r0 ) * cols, ( r1 - r0 ) * cols );
+			}
+		} );
+
+		// a few hundred blocks at most, not worth splitting
+		for ( size_t blk = 1; blk <= nBlk; ++blk ) _offsets[blk] += _offsets[blk - 1];
+		return _offsets.back();
+	}
+
+	void PointCompactor::write( const float* depths, const RayTable& rays, glm::vec3* points, uint32_t* indices, ThreadPool& pool ) const
+	{
+		const int cols    = rays.width();
+		const int rows    = rays.height();
+		const size_t nBlk = _offsets.empty() ? 0 : _offsets.size() - 1;
+		const float* rx   = rays.x();
+		const float* ry   = rays.y();
+
+		pool.parallelFor( 0, nBlk, 1, [&]( size_t b, size_t e ) {
+			for ( size_t blk = b; blk < e; ++blk ) {
+				size_t o          = _offsets[blk];
+				const size_t last = _offsets[blk + 1];  // block's points are [o, last)
+				const int r0      = int( blk ) * blockRows;
+				const int r1 = std::min( r0 + blockRows, rows );
+				for ( int r = r0; r < r1; ++r ) {
+					o = compactRow( depths + size_t( r ) * cols, rx, ry[r], uint32_t( r * cols ), cols, points, indices, o, last );
+				}
+			}
+		} );
+	}
+
+	// -----------------------------------------------------------------------
+
+	void depthToNormalsScalar( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd )
+	{
+		const int cols = rays.width();
+		for ( int r = rowBegin; r < rowEnd; ++r ) {
+			for ( int c = 0; c < cols; ++c ) out[size_t( r ) * cols + c] = normalAt( depths, rays, r, c );
+		}
+	}
+
+	void depthToNormals( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: depthToNormalsSSE2( depths, rays, out, rowBegin, rowEnd ); return;  // avx2 gains little over the sse2 kernel here
+#endif
+			default: depthToNormalsScalar( depths, rays, out, rowBegin, rowEnd ); return;
+		}
+	}
+
+	// -----------------------------------------------------------------------
+
+	void depthToPoints( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2: depthToPointsAVX2( depths, rays, out, rowBegin, rowEnd ); return;
+			case SimdLevel::SSE2: depthToPointsSSE2( depths, rays, out, rowBegin, rowEnd ); return;
+#endif
+#ifdef OFX_STRUCTURE_NEON
+			case SimdLevel::NEON: depthToPointsNEON( depths, rays, out, rowBegin, rowEnd ); return;
+#endif
+			default: depthToPointsScalar( depths, rays, out, rowBegin, rowEnd ); return;
+		}
+	}
+
+	void depthToPoints( const uint16_t* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: depthToPointsSSE2( depths, rays, out, rowBegin, rowEnd ); return;  // the store shuffles dominate, avx2 gains little
+#endif
+#ifdef OFX_STRUCTURE_NEON
+			case SimdLevel::NEON: depthToPointsNEON( depths, rays, out, rowBegin, rowEnd ); return;
+#endif
+			default: depthToPointsScalar( depths, rays, out, rowBegin, rowEnd ); return;
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
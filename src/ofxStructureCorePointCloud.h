@@ -0,0 +1,172 @@
+#pragma once
+#include "ST/CameraFrames.h"
+#include "ofMain.h"
+#include "ofxStructureCoreSimd.h"
+#include "ofxStructureCoreThreadPool.h"
+#include <cstring>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// cached unprojection rays for a depth camera
+	// * pinhole rays are separable: ray(c, r) = ( x[c], y[r], 1 ), x = ( c - cx ) / fx, y = ( r - cy ) / fy
+	// * rebuilt only when the dims or intrinsics change (e.g. ContinuousNonPersistent calibration)
+	// -----------------------------------------------------------------------
+
+	class RayTable
+	{
+	public:
+		// rebuild if needed, returns true if the table changed
+		// stride > 1: rays for every stride-th pixel, width / height are the decimated dims
+		bool update( int width, int height, const ST::Intrinsics& intrinsics, int stride = 1 )
+		{
+			const float key[4] = {intrinsics.fx, intrinsics.fy, intrinsics.cx, intrinsics.cy};
+			if ( _version && width == _width && height == _height && stride == _stride && std::memcmp( key, _key, sizeof( key ) ) == 0 ) {
+				return false;  // bitwise compare, so NaN intrinsics don't rebuild every frame
+			}
+			std::memcpy( _key, key, sizeof( key ) );
+			_width  = width;
+			_height = height;
+			_stride = stride;
+			_x.resize( width );
+			_y.resize( height );
+			for ( int c = 0; c < width; ++c ) _x[c] = ( c * stride - intrinsics.cx ) / intrinsics.fx;  // same rays as the full grid
+			for ( int r = 0; r < height; ++r ) _y[r] = ( r * stride - intrinsics.cy ) / intrinsics.fy;
+			++_version;
+			return true;
+		}
+
+		const float* x() const { return _x.data(); }  // per column
+		const float* y() const { return _y.data(); }  // per row
+		int width() const { return _width; }
+		int height() const { return _height; }
+		int stride() const { return _stride; }
+		uint64_t version() const { return _version; }  // bumped on every rebuild, 0 = never built
+
+	protected:
+		std::vector<float> _x, _y;
+		int _width = 0, _height = 0, _stride = 1;
+		float _key[4];
+		uint64_t _version = 0;
+	};
+
+	// -----------------------------------------------------------------------
+	// cpu point cloud from depth image
+	// * same convention as depth_to_points_vert_shader: millimeters, x / y flipped for opengl
+	// * invalid (0) depth gives (0,0,0)
+	// * point = -depth * ray.x, -depth * ray.y, depth (one multiply per axis)
+	// * so x / y differ by rounding (1-2 ulp) from the original depth * ( c - cx ) / fx * -1 loop, which divided per point
+	// -----------------------------------------------------------------------
+
+	// dispatches to the best kernel for getSimdLevel(), all kernels match depthToPointsScalar() bit for bit
+	// rows [rowBegin, rowEnd) only
+	void depthToPoints( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd );
+
+	inline void depthToPoints( const float* depths, const RayTable& rays, glm::vec3* out )
+	{
+		depthToPoints( depths, rays, out, 0, rays.height() );
+	}
+
+	// 16 bit millimeters (Settings::addon.depthFormat Millimeters16), same points as depthToPoints() on the depth as float
+	void depthToPoints( const uint16_t* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd );
+
+	inline void depthToPoints( const uint16_t* depths, const RayTable& rays, glm::vec3* out )
+	{
+		depthToPoints( depths, rays, out, 0, rays.height() );
+	}
+
+	// rows split across the pool
+	template <typename DepthType>
+	inline void depthToPoints( const DepthType* depths, const RayTable& rays, glm::vec3* out, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, rays.height(), 16, [&]( size_t b, size_t e ) {
+			depthToPoints( depths, rays, out, int( b ), int( e ) );
+		} );
+	}
+
+	// reference implementation, float or uint16_t millimeters (the kernels' reference, not the original loop's rounding)
+	template <typename DepthType>
+	inline void depthToPointsScalar( const DepthType* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd )
+	{
+		const int cols  = rays.width();
+		const float* rx = rays.x();
+		const float* ry = rays.y();
+		for ( int r = rowBegin; r < rowEnd; r++ ) {
+			for ( int c = 0; c < cols; c++ ) {
+				int i       = r * cols + c;
+				float depth = float( depths[i] );  // millimeters
+				// project depth image into metric space
+				// see: http://nicolas.burrus.name/index.php/Research/KinectCalibration
+				out[i].x = -( depth * rx[c] );  // invert x axis for opengl
+				out[i].y = -( depth * ry[r] );  // invert y axis for opengl
+				out[i].z = depth;
+			}
+		}
+	}
+
+	template <typename DepthType>
+	inline void depthToPointsScalar( const DepthType* depths, const RayTable& rays, glm::vec3* out )
+	{
+		depthToPointsScalar( depths, rays, out, 0, rays.height() );
+	}
+
+	// -----------------------------------------------------------------------
+	// surface normals of the organized cloud, straight from depth + rays
+	// * tangents from central differences with the left / right and up / down neighbours
+	// * an invalid neighbour is replaced by the center (one sided difference), both invalid or invalid center gives (0,0,0)
+	// * unit length, facing the sensor
+	// -----------------------------------------------------------------------
+
+	// dispatches to the best kernel for getSimdLevel(), all kernels match depthToNormalsScalar() bit for bit
+	// rows [rowBegin, rowEnd) only, reads the rows around them
+	void depthToNormals( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd );
+
+	inline void depthToNormals( const float* depths, const RayTable& rays, glm::vec3* out )
+	{
+		depthToNormals( depths, rays, out, 0, rays.height() );
+	}
+
+	// rows split across the pool
+	inline void depthToNormals( const float* depths, const RayTable& rays, glm::vec3* out, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, rays.height(), 16, [&]( size_t b, size_t e ) {
+			depthToNormals( depths, rays, out, int( b ), int( e ) );
+		} );
+	}
+
+	// reference implementation
+	void depthToNormalsScalar( const float* depths, const RayTable& rays, glm::vec3* out, int rowBegin, int rowEnd );
+
+	inline void depthToNormalsScalar( const float* depths, const RayTable& rays, glm::vec3* out )
+	{
+		depthToNormalsScalar( depths, rays, out, 0, rays.height() );
+	}
+
+	// -----------------------------------------------------------------------
+	// valid-only point cloud (depth > 0, so NaN is dropped too)
+	// * two passes over blocks of rows: count, exclusive prefix sum of the block counts, write
+	// * points come out in pixel order, with the same values as depthToPoints()
+	// * keeps its block offsets between frames, no allocation once sized
+	// -----------------------------------------------------------------------
+
+	class PointCompactor
+	{
+	public:
+		// pass 1: counts the valid depths, returns the number of points write() will emit
+		size_t count( const float* depths, const RayTable& rays, ThreadPool& pool );
+
+		// pass 2: points and their pixel index (r * cols + c), both need room for count() entries
+		// depths / rays must be the same as in the last count()
+		void write( const float* depths, const RayTable& rays, glm::vec3* points, uint32_t* indices, ThreadPool& pool ) const;
+
+		size_t size() const { return _offsets.empty() ? 0 : _offsets.back(); }
+
+	protected:
+		static const int blockRows = 8;
+		std::vector<size_t> _offsets;  // per block, exclusive, back() = total
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,172 @@
+#include "ofxStructureCoreRegistration.h"
+#include "ofxStructureCoreSimd.h"
+#include <cstring>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	static_assert( sizeof( glm::vec2 ) == 2 * sizeof( float ), "kernels write glm::vec2 as packed uv floats" );
+
+	bool ColorRegistration::update( const RayTable& rays, const ST::Matrix4& visiblePose, const ST::Intrinsics& visibleIntrinsics )
+	{
+		float key[16 + 4];
+		std::memcpy( key, visiblePose.m, sizeof( visiblePose.m ) );
+		key[16] = visibleIntrinsics.fx, key[17] = visibleIntrinsics.fy, key[18] = visibleIntrinsics.cx, key[19] = visibleIntrinsics.cy;
+		if ( _raysVersion == rays.version() && visibleIntrinsics.width == _visibleWidth && visibleIntrinsics.height == _visibleHeight && std::memcmp( key, _key, sizeof( key ) ) == 0 ) {
+			return false;  // bitwise compare, like RayTable
+		}
+		std::memcpy( _key, key, sizeof( key ) );
+		_raysVersion   = rays.version();
+		_visibleWidth  = visibleIntrinsics.width;
+		_visibleHeight = visibleIntrinsics.height;
+
+		// depth -> visible is the inverse pose: R^T, -R^T * t (column major, translation in m30 - m32)
+		double r[3][3], t[3];
+		for ( int row = 0; row < 3; ++row ) {
+			for ( int col = 0; col < 3; ++col ) r[row][col] = visiblePose.m[row * 4 + col];  // transposed
+		}
+		for ( int row = 0; row < 3; ++row ) {
+			t[row] = 0.;
+			for ( int k = 0; k < 3; ++k ) t[row] -= r[row][k] * visiblePose.m[12 + k] * 1000.;  // m -> mm
+		}
+		// fold in the pinhole: K = [ fx 0 cx ; 0 fy cy ; 0 0 1 ]
+		const double k[3][3] = {{visibleIntrinsics.fx, 0., visibleIntrinsics.cx}, {0., visibleIntrinsics.fy, visibleIntrinsics.cy}, {0., 0., 1.}};
+		double kr[3][3], kt[3];
+		for ( int row = 0; row < 3; ++row ) {
+			kt[row] = 0.;
+			for ( int col = 0; col < 3; ++col ) {
+				kr[row][col] = 0.;
+				for ( int j = 0; j < 3; ++j ) kr[row][col] += k[row][j] * r[j][col];
+			}
+			for ( int j = 0; j < 3; ++j ) kt[row] += k[row][j] * t[j];
+		}
+		for ( int col = 0; col < 3; ++col ) {
+			for ( int row = 0; row < 3; ++row ) _kr[col][row] = float( kr[row][col] );  // glm is column major
+		}
+		_kt = glm::vec3( kt[0], kt[1], kt[2] );
+
+		_colX.resize( rays.width() );
+		_colY.resize( rays.width() );
+		_colZ.resize( rays.width() );
+		_rows.resize( rays.height() );
+		for ( int c = 0; c < rays.width(); ++c ) {
+			const double x = rays.x()[c];
+			_colX[c]       = float( kr[0][0] * x );
+			_colY[c]       = float( kr[1][0] * x );
+			_colZ[c]       = float( kr[2][0] * x );
+		}
+		for ( int rr = 0; rr < rays.height(); ++rr ) {
+			const double y = rays.y()[rr];
+			_rows[rr]      = glm::vec3( kr[0][1] * y + kr[0][2], kr[1][1] * y + kr[1][2], kr[2][1] * y + kr[2][2] );
+		}
+		return true;
+	}
+
+	void ColorRegistration::projectRowsScalar( const float* depths, glm::vec2* uvs, int rowBegin, int rowEnd ) const
+	{
+		const int cols = int( _colX.size() );
+		for ( int r = rowBegin; r < rowEnd; ++r ) {
+			const float* d = depths + size_t( r ) * cols;
+			glm::vec2* out = uvs + size_t( r ) * cols;
+			for ( int c = 0; c < cols; ++c ) out[c] = projectPixel( d[c], c, _rows[r] );
+		}
+	}
+
+#ifdef OFX_STRUCTURE_X64
+	void ColorRegistration::projectRowsSSE2( const float* depths, glm::vec2* uvs, int rowBegin, int rowEnd ) const
+	{
+		const int cols      = int( _colX.size() );
+		const __m128 zero   = _mm_setzero_ps();
+		const __m128 none   = _mm_set1_ps( -1.f );
+		const __m128 width  = _mm_set1_ps( float( _visibleWidth ) );
+		const __m128 height = _mm_set1_ps( float( _visibleHeight ) );
+		const __m128 ktx    = _mm_set1_ps( _kt.x );
+		const __m128 kty    = _mm_set1_ps( _kt.y );
+		const __m128 ktz    = _mm_set1_ps( _kt.z );
+		for ( int r = rowBegin; r < rowEnd; ++r ) {
+			const float* d    = depths + size_t( r ) * cols;
+			glm::vec2* out    = uvs + size_t( r ) * cols;
+			const __m128 rowX = _mm_set1_ps( _rows[r].x );
+			const __m128 rowY = _mm_set1_ps( _rows[r].y );
+			const __m128 rowZ = _mm_set1_ps( _rows[r].z );
+			int c             = 0;
+			for ( ; c + 4 <= cols; c += 4 ) {
+				const __m128 depth = _mm_loadu_ps( d + c );
+				const __m128 x     = _mm_add_ps( _mm_mul_ps( depth, _mm_add_ps( _mm_loadu_ps( &_colX[c] ), rowX ) ), ktx );
+				const __m128 y     = _mm_add_ps( _mm_mul_ps( depth, _mm_add_ps( _mm_loadu_ps( &_colY[c] ), rowY ) ), kty );
+				const __m128 z     = _mm_add_ps( _mm_mul_ps( depth, _mm_add_ps( _mm_loadu_ps( &_colZ[c] ), rowZ ) ), ktz );
+				const __m128 u     = _mm_div_ps( x, z );
+				const __m128 v     = _mm_div_ps( y, z );
+				__m128 ok          = _mm_and_ps( _mm_cmpgt_ps( depth, zero ), _mm_cmpgt_ps( z, zero ) );
+				ok                 = _mm_and_ps( ok, _mm_and_ps( _mm_cmpge_ps( u, zero ), _mm_cmpge_ps( v, zero ) ) );
+				ok                 = _mm_and_ps( ok, _mm_and_ps( _mm_cmplt_ps( u, width ), _mm_cmplt_ps( v, height ) ) );
+				const __m128 su    = _mm_or_ps( _mm_and_ps( ok, u ), _mm_andnot_ps( ok, none ) );
+				const __m128 sv    = _mm_or_ps( _mm_and_ps( ok, v ), _mm_andnot_ps( ok, none ) );
+				float* o           = &out[c].x;
+				_mm_storeu_ps( o, _mm_unpacklo_ps( su, sv ) );  // interleave to u0 v0 u1 v1
+				_mm_storeu_ps( o + 4, _mm_unpackhi_ps( su, sv ) );
+			}
+			for ( ; c < cols; ++c ) out[c] = projectPixel( d[c], c, _rows[r] );
+		}
+	}
+#endif
+
+	void ColorRegistration::project( const float* depths, const uint32_t* indices, size_t n, glm::vec2* uvs, ThreadPool& pool ) const
+	{
+		if ( indices ) {
+			const uint32_t cols = uint32_t( _colX.size() );
+			pool.parallelFor( 0, n, 4096, [&]( size_t b, size_t e ) {
+				for ( size_t i = b; i < e; ++i ) {
+					const uint32_t p = indices[i];
+					uvs[i]           = projectPixel( depths[p], p % cols, _rows[p / cols] );
+				}
+			} );
+			return;
+		}
+		pool.parallelFor( 0, _rows.size(), 16, [&]( size_t b, size_t e ) {
+			switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+				case SimdLevel::AVX2:
+				case SimdLevel::SSE2: projectRowsSSE2( depths, uvs, int( b ), int( e ) ); return;
+#endif
+				default: projectRowsScalar( depths, uvs, int( b ), int( e ) ); return;
+			}
+		} );
+	}
+
+	void ColorRegistration::projectPoints( const glm::vec3* points, size_t n, glm::vec2* uvs, ThreadPool& pool ) const
+	{
+		pool.parallelFor( 0, n, 4096, [&]( size_t b, size_t e ) {
+			for ( size_t i = b; i < e; ++i ) {
+				const glm::vec3& p = points[i];
+				if ( !( p.z > 0.f ) ) {
+					uvs[i] = glm::vec2( -1.f, -1.f );
+					continue;
+				}
+				const glm::vec3 h = _kr * glm::vec3( -p.x, -p.y, p.z ) + _kt;  // undo the opengl flip
+				uvs[i]            = toUv( h.x, h.y, h.z );
+			}
+		} );
+	}
+
+	void ColorRegistration::sample( const glm::vec2* uvs, size_t n, const uint8_t* rgb, int width, int height, ofFloatColor* colors, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, n, 4096, [&]( size_t b, size_t e ) {
+			for ( size_t i = b; i < e; ++i ) {
+				const glm::vec2 uv = uvs[i];
+				const int u        = int( uv.x ), v = int( uv.y );
+				const bool ok      = uv.x >= 0.f && u < width && v < height;
+				const uint8_t* px  = rgb + ( ok ? ( size_t( v ) * width + u ) * 3 : 0 );  // unmapped points read pixel 0 and scale it to 0
+				const float scale  = ok ? 1.f / 255.f : 0.f;
+				colors[i]          = ofFloatColor( px[0] * scale, px[1] * scale, px[2] * scale, ok ? 1.f : 0.f );
+			}
+		} );
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,73 @@
+#pragma once
+#include "ST/CameraFrames.h"
+#include "ST/MathTypes.h"
+#include "ofMain.h"
+#include "ofxStructureCorePointCloud.h"
+#include "ofxStructureCoreThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// depth -> visible camera registration on the cpu
+	// * projects depth points into the visible image with the visible camera pose and intrinsics,
+	//   so it works whether or not the SDK registered depth to color (DepthFrame::isRegisteredTo())
+	// * the projection is separable like the rays: ( u, v, w ) * w = depth * ( col[c] + row[r] ) + t,
+	//   with K * R folded into the per column / per row tables, rebuilt only when an input changes
+	// * uvs are visibleImg pixel coords (rect texture coords), ( -1, -1 ) where there's no color:
+	//   invalid depth, behind the visible camera or outside its image
+	// -----------------------------------------------------------------------
+
+	class ColorRegistration
+	{
+	public:
+		// rebuild the tables if needed, returns true if they changed
+		// visiblePose: the visible camera in depth coordinates (DepthFrame::visibleCameraPoseInDepthCoordinateFrame()), translation in meters
+		bool update( const RayTable& rays, const ST::Matrix4& visiblePose, const ST::Intrinsics& visibleIntrinsics );
+
+		// uvs for the grid pixels in indices (compact point cloud), or all rays.width() * rays.height() pixels if indices is nullptr
+		// depths is the grid the rays were built for, n is the number of indices (ignored if nullptr)
+		// the whole grid goes through a simd kernel for getSimdLevel() that matches the scalar loop bit for bit
+		void project( const float* depths, const uint32_t* indices, size_t n, glm::vec2* uvs, ThreadPool& pool ) const;
+
+		// uvs for unorganized points in point cloud coords (e.g. voxel grid output)
+		void projectPoints( const glm::vec3* points, size_t n, glm::vec2* uvs, ThreadPool& pool ) const;
+
+		// nearest rgb pixel for each uv, alpha 0 where there's no color
+		static void sample( const glm::vec2* uvs, size_t n, const uint8_t* rgb, int width, int height, ofFloatColor* colors, ThreadPool& pool );
+
+		int visibleWidth() const { return _visibleWidth; }
+		int visibleHeight() const { return _visibleHeight; }
+
+	protected:
+		std::vector<float> _colX, _colY, _colZ;  // K * R * ( x[c], 0, 0 )
+		std::vector<glm::vec3> _rows;            // K * R * ( 0, y[r], 1 )
+		glm::mat3 _kr;                           // K * R, for unorganized points
+		glm::vec3 _kt;                           // K * t, mm
+		int _visibleWidth = 0, _visibleHeight = 0;
+		uint64_t _raysVersion = 0;
+		float _key[16 + 4];  // pose + intrinsics the tables were built for
+
+		// homogeneous visible pixel -> uv, the simd kernels make the same checks in the same order
+		inline glm::vec2 toUv( float x, float y, float z ) const
+		{
+			if ( !( z > 0.f ) ) return {-1.f, -1.f};
+			const float u = x / z, v = y / z;
+			if ( !( u >= 0.f && v >= 0.f && u < _visibleWidth && v < _visibleHeight ) ) return {-1.f, -1.f};
+			return {u, v};
+		}
+
+		inline glm::vec2 projectPixel( float d, int c, const glm::vec3& row ) const
+		{
+			if ( !( d > 0.f ) ) return {-1.f, -1.f};
+			return toUv( d * ( _colX[c] + row.x ) + _kt.x, d * ( _colY[c] + row.y ) + _kt.y, d * ( _colZ[c] + row.z ) + _kt.z );
+		}
+
+		void projectRowsScalar( const float* depths, glm::vec2* uvs, int rowBegin, int rowEnd ) const;
+		void projectRowsSSE2( const float* depths, glm::vec2* uvs, int rowBegin, int rowEnd ) const;
+	};
+
+}  // namespace structure
+}  // namespace ofx
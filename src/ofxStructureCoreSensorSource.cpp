@@ -0,0 +1,238 @@
+#ifndef OFX_STRUCTURE_CORE_NO_SDK
+#include "ofxStructureCoreSensorSource.h"
+#include "ofMain.h"
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+		// the frame's metadata, data / chroma / channels are left to resolvePixels()
+
+		DepthFrameView viewOf( const ST::DepthFrame& frame )
+		{
+			DepthFrameView view;
+			view.width            = frame.width();
+			view.height           = frame.height();
+			view.timestamp        = frame.timestamp();
+			view.arrivalTimestamp = frame.arrivalTimestamp();
+			view.intrinsics       = frame.intrinsics();
+			view.visiblePose      = frame.visibleCameraPoseInDepthCoordinateFrame();  // valid whether or not depth is registered to color
+			return view;
+		}
+
+		InfraredFrameView viewOf( const ST::InfraredFrame& frame )
+		{
+			InfraredFrameView view;
+			view.width            = frame.width();
+			view.height           = frame.height();
+			view.timestamp        = frame.timestamp();
+			view.arrivalTimestamp = frame.arrivalTimestamp();
+			view.intrinsics       = frame.intrinsics();
+			return view;
+		}
+
+		VisibleFrameView viewOf( const ST::ColorFrame& frame )
+		{
+			VisibleFrameView view;
+			view.width                       = frame.width();
+			view.height                      = frame.height();
+			view.timestamp                   = frame.timestamp();
+			view.arrivalTimestamp            = frame.arrivalTimestamp();
+			view.endOfExposureTimestamp      = frame.endOfExposureTimestamp();
+			view.endOfPreprocessingTimestamp = frame.endOfPreprocessingTimestamp();
+			view.intrinsics                  = frame.intrinsics();
+			return view;
+		}
+
+		// the sdk's pixel accessors, called with the frame's lock held
+
+		void lookUpPixels( const SensorFrame<ST::DepthFrame, float>& held )
+		{
+			held.data = held.frame.depthInMillimeters();  // converts
+		}
+
+		void lookUpPixels( const SensorFrame<ST::InfraredFrame, uint16_t>& held )
+		{
+			held.data = held.frame.data();
+		}
+
+		void lookUpPixels( const SensorFrame<ST::ColorFrame, uint8_t>& held )
+		{
+			const auto& frame = held.frame;
+			const int width   = frame.width();
+			const int height  = frame.height();
+			if ( held.ycbcr && frame.ySize() == size_t( width ) * height && frame.cbcrSize() == chromaSize( width, height ) ) {
+				held.data   = frame.yData();  // rgbData() would convert
+				held.chroma = frame.cbcrData();
+			} else {
+				held.data     = frame.rgbData();  // also for an unexpected plane layout
+				held.channels = 3;
+			}
+		}
+
+		// FrameHandle::Resolver, the first handle to read the frame looks its pixels up, the others reuse them
+		template <typename FrameType, typename PixelType>
+		void resolvePixels( const void* owner, FrameView<PixelType>& view )
+		{
+			const auto& held = *static_cast<const SensorFrame<FrameType, PixelType>*>( owner );
+			std::lock_guard<std::mutex> lck( held.lock );
+			if ( !held.resolved ) {
+				lookUpPixels( held );
+				held.resolved = true;
+			}
+			view.data     = held.data;
+			view.chroma   = held.chroma;
+			view.channels = held.channels;
+		}
+
+		// clone the sample's frame into a pooled item no handle refers to anymore
+		template <typename FrameType, typename PixelType>
+		std::shared_ptr<SensorFrame<FrameType, PixelType>> hold( FramePool<SensorFrame<FrameType, PixelType>>& pool, const FrameType& frame, bool ycbcr = false )
+		{
+			auto held      = pool.acquire();
+			held->frame    = frame;  // the sdk's copy assignment, see SensorFrameSource
+			held->ycbcr    = ycbcr;
+			held->resolved = false;
+			held->data     = nullptr;
+			held->chroma   = nullptr;
+			held->channels = 1;
+			return held;
+		}
+	}  // namespace
+
+	SensorFrameSource::SensorFrameSource()
+	{
+		_captureSession.setDelegate( this );
+	}
+
+	bool SensorFrameSource::setup( const Settings& settings )
+	{
+		_visibleYCbCr = settings.addon.visibleYCbCr;
+		if ( !_captureSession.startMonitoring( settings ) ) {
+			return false;
+		}
+		// HACK: if we have requested a serial number, the Structure SDK needs this thread to sleep for a bit before we can call startStreaming()
+		// very weird, but seems like the only fix right now
+		std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+		return true;
+	}
+
+	bool SensorFrameSource::startStreaming()
+	{
+		{
+			std::unique_lock<std::shared_mutex> lck( _deliveryLock );
+			_delivering = true;
+		}
+		return _captureSession.startStreaming();
+	}
+
+	void SensorFrameSource::stopStreaming()
+	{
+		_captureSession.stopStreaming();
+		std::unique_lock<std::shared_mutex> lck( _deliveryLock );  // the sdk may still be inside a callback
+		_delivering = false;
+	}
+
+	std::string SensorFrameSource::serial() const
+	{
+		return std::string( &_captureSession.sensorInfo().serialNumber[0] );
+	}
+
+	double SensorFrameSource::now() const
+	{
+		return ST::getTimestampNow();  // the sdk's clock, same as frame timestamps
+	}
+
+	// the sample's frames are only valid during the callback, keep a clone, its pixels are looked up by whoever reads them
+
+	void SensorFrameSource::emit( const ST::DepthFrame& frame )
+	{
+		auto held = hold( _depthFrames, frame );
+		_delegate->handleNewFrame( makeFrameHandle( held, viewOf( held->frame ), &resolvePixels<ST::DepthFrame, float> ) );
+	}
+
+	void SensorFrameSource::emit( const ST::InfraredFrame& frame )
+	{
+		auto held = hold( _irFrames, frame );
+		_delegate->handleNewFrame( makeFrameHandle( held, viewOf( held->frame ), &resolvePixels<ST::InfraredFrame, uint16_t> ) );
+	}
+
+	void SensorFrameSource::emit( const ST::ColorFrame& frame )
+	{
+		auto held = hold( _visibleFrames, frame, _visibleYCbCr );
+		_delegate->handleNewFrame( makeFrameHandle( held, viewOf( held->frame ), &resolvePixels<ST::ColorFrame, uint8_t> ) );
+	}
+
+	void SensorFrameSource::captureSessionEventDidOccur( ST::CaptureSession* session, ST::CaptureSessionEventId evt )
+	{
+		if ( session != &_captureSession ) {
+			ofLogError( "ofxStructureCore" ) << "Received capture session event for unknown capture session: " << session;
+		} else if ( _delegate ) {
+			_delegate->handleSessionEvent( evt );
+		}
+	}
+
+	void SensorFrameSource::captureSessionDidOutputSample( ST::CaptureSession*, const ST::CaptureSessionSample& sample )
+	{
+		std::shared_lock<std::shared_mutex> lck( _deliveryLock );  // callbacks don't block each other
+		if ( !_delegate || !_delivering ) return;
+
+		using Type = ST::CaptureSessionSample::Type;
+		switch ( sample.type ) {
+			case Type::DepthFrame: {
+				emit( sample.depthFrame );
+			} break;
+
+			case Type::VisibleFrame: {
+				emit( sample.visibleFrame );
+			} break;
+
+			case Type::InfraredFrame: {
+				emit( sample.infraredFrame );
+			} break;
+
+			case Type::SynchronizedFrames: {
+				if ( sample.depthFrame.isValid() ) {
+					emit( sample.depthFrame );
+				}
+				if ( sample.visibleFrame.isValid() ) {
+					emit( sample.visibleFrame );
+				}
+				if ( sample.infraredFrame.isValid() ) {
+					emit( sample.infraredFrame );
+				}
+			} break;
+
+			case Type::AccelerometerEvent: {
+				auto a = sample.accelerometerEvent.acceleration();
+				ImuSample s;
+				s.type             = ImuSample::Type::Accelerometer;
+				s.x                = a.x;
+				s.y                = a.y;
+				s.z                = a.z;
+				s.timestamp        = sample.accelerometerEvent.timestamp();
+				s.arrivalTimestamp = sample.accelerometerEvent.arrivalTimestamp();
+				_delegate->handleNewSample( s );
+			} break;
+
+			case Type::GyroscopeEvent: {
+				auto r = sample.gyroscopeEvent.rotationRate();
+				ImuSample s;
+				s.type             = ImuSample::Type::Gyroscope;
+				s.x                = r.x;
+				s.y                = r.y;
+				s.z                = r.z;
+				s.timestamp        = sample.gyroscopeEvent.timestamp();
+				s.arrivalTimestamp = s.timestamp;  // gyro events carry no arrival time
+				_delegate->handleNewSample( s );
+			} break;
+
+			default: {
+				ofLogWarning( "ofxStructureCore" ) << "Unhandled frame type: " << ST::CaptureSessionSample::toString( sample.type );
+			} break;
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
+#endif
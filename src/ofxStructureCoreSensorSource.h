@@ -0,0 +1,73 @@
+#pragma once
+#include "ST/CameraFrames.h"
+#include "ST/CaptureSession.h"
+#include "ST/IMUEvents.h"
+#include "ofxStructureCoreFrameSource.h"
+#include <mutex>
+#include <shared_mutex>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// frames from a Structure Core, via the Structure SDK CaptureSession
+	// * each frame is handed on as a clone of the SDK frame (its copy assignment, which the SDK
+	//   headers don't document as sharing the buffer, so ingest may still copy the pixels once),
+	//   the clones are pooled so they're reused once the delegate lets go of them
+	// * the sdk callback only clones: depthInMillimeters() / rgbData() (which convert) and the other
+	//   pixel accessors run on the thread that first resolves a handle, see FrameHandle::resolve()
+	// -----------------------------------------------------------------------
+
+	// a pooled sdk frame clone, its pixels are looked up once, for all handles to it
+	template <typename FrameType, typename PixelType>
+	struct SensorFrame
+	{
+		FrameType frame;
+		bool ycbcr = false;  // visible: hand on the luma + CbCr planes if their layout allows (Settings::addon.visibleYCbCr)
+
+		mutable std::mutex lock;
+		mutable bool resolved           = false;
+		mutable const PixelType* data   = nullptr;
+		mutable const PixelType* chroma = nullptr;
+		mutable int channels            = 1;
+	};
+
+	class SensorFrameSource : public FrameSource, public ST::CaptureSessionDelegate
+	{
+	public:
+		SensorFrameSource();
+
+		bool setup( const Settings& settings ) override;
+		bool startStreaming() override;
+		void stopStreaming() override;
+		std::string serial() const override;
+		ST::Matrix4 imuFromDepth() const override { return _captureSession.getImuFromDepthExtrinsics(); }
+		ST::Matrix4 imuFromVisible() const override { return _captureSession.getImuFromVisibleExtrinsics(); }
+		double now() const override;
+
+		ST::CaptureSession& captureSession() { return _captureSession; }
+		const ST::CaptureSession& captureSession() const { return _captureSession; }
+
+		// delegate functions overrides
+		void captureSessionEventDidOccur( ST::CaptureSession* session, ST::CaptureSessionEventId evt ) override;
+		void captureSessionDidOutputSample( ST::CaptureSession*, const ST::CaptureSessionSample& sample ) override;
+
+	protected:
+		ST::CaptureSession _captureSession;
+		bool _visibleYCbCr = false;  // Settings::addon.visibleYCbCr
+
+		// samples are handed on while streaming, stopStreaming() waits out the one being delivered
+		std::shared_mutex _deliveryLock;
+		bool _delivering = false;
+
+		FramePool<SensorFrame<ST::DepthFrame, float>> _depthFrames;
+		FramePool<SensorFrame<ST::InfraredFrame, uint16_t>> _irFrames;
+		FramePool<SensorFrame<ST::ColorFrame, uint8_t>> _visibleFrames;
+
+		void emit( const ST::DepthFrame& frame );
+		void emit( const ST::InfraredFrame& frame );
+		void emit( const ST::ColorFrame& frame );
+	};
+
+}  // namespace structure
+}  // namespace ofx
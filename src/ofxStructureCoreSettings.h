@@ -4,6 +4,12 @@
 #include "ST/IMUEvents.h"
 #include "ST/OCCFileWriter.h"
 #include "ST/Utilities.h"
+#include "ofxStructureCoreDepthFilter.h"
+#include "ofxStructureCoreOrientation.h"
+#include "ofxStructureCoreTemporalFilter.h"
+#include <map>
+#include <string>
+#include <vector>
 
 namespace ofx {
 namespace structure {
@@ -72,8 +78,70 @@ namespace structure {
 		std::string _serial;
 
 	public:
+		// addon-side options (not passed to the SDK)
+		struct AddonSettings
+		{
+			// frames kept per stream for timestamp queries (0 = off)
+			size_t depthHistorySize    = 0;
+			size_t infraredHistorySize = 0;
+			size_t visibleHistorySize  = 0;
+
+			// every imu sample is kept per sensor (accelerometer / gyroscope) for drain / range queries, see ofxStructureCore::getImuQueue()
+			size_t imuQueueSize = 4096;  // rounded up to a power of two, ~5 s at 800 Hz
+
+			// orientation fused from every imu sample on the imu thread, see ofxStructureCore::getOrientation()
+			ofx::structure::OrientationFilterParams orientation;
+
+			bool useTextures       = true;   // upload depthImg / irImg / visibleImg textures in update() (false for headless)
+			bool lazyImages        = false;  // fill depthImg / irImg / visibleImg only when read through their getters, not in update()
+			bool visibleYCbCr      = false;  // keep visible frames as the sdk's luma + CbCr planes (no sdk rgb conversion), see visibleLumaImg / getVisibleRgb()
+			bool buildPointCloud   = true;   // update pointcloud in update()
+			bool compactPointCloud = false;  // only valid points + their pixel index (cpu path), see PointCloud::indices
+
+			// point cloud downsampling (cpu path)
+			int pointStride = 1;    // unproject every n-th pixel of every n-th row (1 = all)
+			float voxelSize = 0.f;  // one point per voxel of this size in mm, the centroid (0 = off)
+
+			// depth image format, Millimeters16 halves depth memory and texture upload (see ofxStructureCoreDepthFormat.h)
+			// Float: depthImg, Millimeters16: depthMmImg as uint16_t mm (GL_R16), depthImg stays empty
+			enum class DepthFormat
+			{
+				Float,
+				Millimeters16
+			};
+			DepthFormat depthFormat = DepthFormat::Float;
+
+			// cpu filters run in order on depthImg before the point cloud, empty = off
+			// tunable alternative to structureCore.applyExpensiveCorrection, see ofxStructureCore::getDepthFilterChain()
+			std::vector<ofx::structure::DepthFilterStage> depthFilters;
+
+			// smoothing + hole persistence over time, after depthFilters, see ofxStructureCore::getTemporalFilter()
+			ofx::structure::TemporalFilterParams temporalFilter;
+
+			// color from visibleImg, registered on the cpu with the depth frame's visible camera pose (needs the visible stream)
+			// Rgb: pointcloud.colors, TexCoords: pointcloud.texCoords in visibleImg pixels (draw with visibleImg.getTexture() bound)
+			enum class PointColors
+			{
+				Off,
+				Rgb,
+				TexCoords
+			};
+			PointColors pointColors = PointColors::Off;
+
+			bool computeNormals = false;  // pointcloud.normals from the depth grid (not with voxelSize)
+
+			// triangles between neighbouring pixels, see PointCloud::drawMesh() (not with compactPointCloud / voxelSize)
+			bool buildMesh         = false;
+			float meshMaxDepthJump = 30.f;  // mm, triangles spanning more depth than this are dropped
+
+			// worker pool for cpu point cloud work
+			size_t threads = 0;               // incl. the app thread, 0 = all cores, 1 = no workers
+			std::vector<int> threadAffinity;  // cpu ids to pin workers to (round robin), empty = unpinned
+		} addon;
+
 		Settings( const Settings& other )
 		    : ST::CaptureSessionSettings( other )
+		    , addon( other.addon )
 		{
 			setSerial( other._serial );
 		}
@@ -81,6 +149,7 @@ namespace structure {
 		Settings& operator=( const Settings& other )
 		{
 			ST::CaptureSessionSettings::operator=( other );
+			addon = other.addon;
 			setSerial( other._serial );
 			return *this;
 		}
@@ -0,0 +1,66 @@
+#include "ofxStructureCoreSimd.h"
+#include <atomic>
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+		bool isSupported( SimdLevel level )
+		{
+			switch ( level ) {
+				case SimdLevel::Scalar: return true;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+				case SimdLevel::SSE2: return true;  // x64 baseline
+				case SimdLevel::AVX2: {
+#if defined( _MSC_VER )
+					int info[4];
+					__cpuid( info, 0 );
+					if ( info[0] < 7 ) return false;
+					__cpuidex( info, 7, 0 );
+					bool avx2 = ( info[1] & ( 1 << 5 ) ) != 0;
+					__cpuid( info, 1 );
+					bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+					return avx2 && osxsave && ( _xgetbv( 0 ) & 0x6 ) == 0x6;  // os saves ymm state
+#else
+					return __builtin_cpu_supports( "avx2" );
+#endif
+				}
+#endif
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( _M_ARM64 )
+				case SimdLevel::NEON: return true;
+#endif
+				default: return false;
+			}
+		}
+
+		std::atomic<int>& currentLevel()
+		{
+			static std::atomic<int> level{int( detectSimdLevel() )};
+			return level;
+		}
+	}  // namespace
+
+	SimdLevel detectSimdLevel()
+	{
+		for ( auto level : {SimdLevel::AVX2, SimdLevel::NEON, SimdLevel::SSE2} ) {
+			if ( isSupported( level ) ) return level;
+		}
+		return SimdLevel::Scalar;
+	}
+
+	SimdLevel getSimdLevel()
+	{
+		return SimdLevel( currentLevel().load( std::memory_order_relaxed ) );
+	}
+
+	void setSimdLevel( SimdLevel level )
+	{
+		currentLevel() = int( isSupported( level ) ? level : detectSimdLevel() );
+	}
+
+}  // namespace structure
+}  // namespace ofx
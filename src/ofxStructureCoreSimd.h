@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// runtime simd dispatch for the cpu kernels
+	// * detected once, can be lowered with setSimdLevel() (e.g. to compare against Scalar)
+	// -----------------------------------------------------------------------
+
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON
+	};
+
+	SimdLevel detectSimdLevel();  // best level this cpu / build supports
+	SimdLevel getSimdLevel();     // level the kernels currently use
+	void setSimdLevel( SimdLevel level );  // falls back to the detected level if unsupported
+
+	inline std::string to_string( SimdLevel level )
+	{
+		switch ( level ) {
+			case SimdLevel::SSE2: return "SSE2";
+			case SimdLevel::AVX2: return "AVX2";
+			case SimdLevel::NEON: return "NEON";
+			default: return "Scalar";
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
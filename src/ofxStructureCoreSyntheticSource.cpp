@@ -0,0 +1,374 @@
+#include "ofxStructureCoreSyntheticSource.h"
+#include <chrono>
+#include <cmath>
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+		const double kPi = 3.14159265358979323846;
+
+		ST::Intrinsics makeIntrinsics( int width, int height, float hfovDegrees )
+		{
+			ST::Intrinsics intr;
+			intr.width  = width;
+			intr.height = height;
+			intr.fx     = width * 0.5f / std::tan( hfovDegrees * 0.5f * float( kPi ) / 180.f );
+			intr.fy     = intr.fx;
+			intr.cx     = width * 0.5f;
+			intr.cy     = height * 0.5f;
+			intr.k1 = intr.k2 = intr.k3 = intr.p1 = intr.p2 = 0.f;
+			return intr;
+		}
+
+		float imuRateHz( Settings::IMURate rate )
+		{
+			switch ( rate ) {
+				case Settings::IMURate::AccelAndGyro_100Hz: return 100.f;
+				case Settings::IMURate::AccelAndGyro_200Hz: return 200.f;
+				case Settings::IMURate::AccelAndGyro_1000Hz: return 1000.f;
+				default: return 800.f;
+			}
+		}
+	}  // namespace
+
+	SyntheticFrameSource::SyntheticFrameSource()
+	    : SyntheticFrameSource( Options() )
+	{
+	}
+
+	SyntheticFrameSource::SyntheticFrameSource( const Options& options )
+	    : _options( options )
+	{
+	}
+
+	SyntheticFrameSource::~SyntheticFrameSource()
+	{
+		stopStreaming();
+	}
+
+	bool SyntheticFrameSource::setup( const Settings& settings )
+	{
+		stopStreaming();
+
+		const auto& sc = settings.structureCore;
+		switch ( sc.depthResolution ) {
+			case Settings::DepthResolution::_320x240: _depthW = 320, _depthH = 240; break;
+			case Settings::DepthResolution::_1280x960: _depthW = 1280, _depthH = 960; break;
+			default: _depthW = 640, _depthH = 480; break;
+		}
+		_depthEnabled   = sc.depthEnabled;
+		_irEnabled      = sc.infraredEnabled;
+		_visibleEnabled = sc.visibleEnabled;
+		_imuEnabled     = sc.accelerometerEnabled || sc.gyroscopeEnabled;
+		_irBothCameras  = sc.infraredMode == Settings::IRMode::BothCameras;
+		_visibleYCbCr   = settings.addon.visibleYCbCr;
+		_depthRate      = sc.depthFramerate;
+		_irRate         = sc.infraredFramerate;
+		_visibleRate    = sc.visibleFramerate;
+		_imuRate        = imuRateHz( sc.imuUpdateRate );
+
+		_depthIntrinsics   = makeIntrinsics( _depthW, _depthH, 59.f );
+		_irIntrinsics      = makeIntrinsics( _options.infraredWidth, _options.infraredHeight, 59.f );
+		_visibleIntrinsics = makeIntrinsics( _options.visibleWidth, _options.visibleHeight, 59.f );
+
+		_frameIndex = 0;
+		_imuIndex   = 0;
+		_start      = std::chrono::steady_clock::now();
+
+		if ( _delegate ) {
+			_delegate->handleSessionEvent( EventType::Connected );
+			_delegate->handleSessionEvent( EventType::Ready );
+		}
+		return true;
+	}
+
+	bool SyntheticFrameSource::startStreaming()
+	{
+		if ( _streaming ) return true;
+		_start       = std::chrono::steady_clock::now();
+		_streaming   = true;
+		_frameThread = std::thread( &SyntheticFrameSource::frameLoop, this );
+		if ( _imuEnabled ) {
+			_imuThread = std::thread( &SyntheticFrameSource::imuLoop, this );
+		}
+		if ( _delegate ) {
+			_delegate->handleSessionEvent( EventType::Streaming );
+		}
+		return true;
+	}
+
+	void SyntheticFrameSource::stopStreaming()
+	{
+		_streaming = false;
+		if ( _frameThread.joinable() ) _frameThread.join();
+		if ( _imuThread.joinable() ) _imuThread.join();
+	}
+
+	void SyntheticFrameSource::step()
+	{
+		uint64_t n = _frameIndex++;
+		if ( _imuEnabled && _depthRate > 0.f ) {
+			// imu samples up to this frame's timestamp
+			double frameT = n / double( _depthRate );
+			while ( _imuIndex / double( _imuRate ) <= frameT ) {
+				emitImu( _imuIndex++ );
+			}
+		}
+		if ( _depthEnabled ) emitDepth( n );
+		if ( _irEnabled ) emitInfrared( n );
+		if ( _visibleEnabled ) emitVisible( n );
+	}
+
+	// threads
+
+	void SyntheticFrameSource::frameLoop()
+	{
+		using clock = std::chrono::steady_clock;
+
+		if ( !_options.realtime ) {
+			while ( _streaming ) step();
+			return;
+		}
+
+		// each stream runs on its own schedule: frame k is due at start + k / rate
+		struct Schedule
+		{
+			bool enabled;
+			float rate;
+			uint64_t next;
+			void ( SyntheticFrameSource::*emit )( uint64_t );
+		} streams[] = {
+		    {_depthEnabled, _depthRate, 0, &SyntheticFrameSource::emitDepth},
+		    {_irEnabled, _irRate, 0, &SyntheticFrameSource::emitInfrared},
+		    {_visibleEnabled, _visibleRate, 0, &SyntheticFrameSource::emitVisible}};
+
+		while ( _streaming ) {
+			Schedule* due = nullptr;
+			double dueT   = 0.;
+			for ( auto& s : streams ) {
+				if ( !s.enabled || s.rate <= 0.f ) continue;
+				double t = s.next / double( s.rate );
+				if ( !due || t < dueT ) {
+					due  = &s;
+					dueT = t;
+				}
+			}
+			if ( !due ) break;
+			std::this_thread::sleep_until( _start + std::chrono::duration_cast<clock::duration>( std::chrono::duration<double>( dueT ) ) );
+			( this->*due->emit )( due->next++ );
+		}
+	}
+
+	void SyntheticFrameSource::imuLoop()
+	{
+		using clock = std::chrono::steady_clock;
+		uint64_t n  = 0;
+		while ( _streaming ) {
+			if ( _options.realtime ) {
+				std::this_thread::sleep_until( _start + std::chrono::duration_cast<clock::duration>( std::chrono::duration<double>( n / double( _imuRate ) ) ) );
+			}
+			emitImu( n++ );
+		}
+	}
+
+	// emit
+
+	// generated into pooled frames, handed on without a copy
+
+	void SyntheticFrameSource::emitDepth( uint64_t n )
+	{
+		auto frame = _depthFrames.acquire();
+		generateDepth( n, *frame );
+		frame->arrivalTimestamp = now();
+		if ( _delegate ) _delegate->handleNewFrame( makeFrameHandle<float>( frame ) );
+	}
+
+	void SyntheticFrameSource::emitInfrared( uint64_t n )
+	{
+		auto frame = _irFrames.acquire();
+		generateInfrared( n, *frame );
+		frame->arrivalTimestamp = now();
+		if ( _delegate ) _delegate->handleNewFrame( makeFrameHandle<uint16_t>( frame ) );
+	}
+
+	void SyntheticFrameSource::emitVisible( uint64_t n )
+	{
+		auto frame = _visibleFrames.acquire();
+		generateVisible( n, *frame );
+		frame->arrivalTimestamp = now();
+		if ( _delegate ) _delegate->handleNewFrame( makeFrameHandle<uint8_t>( frame ) );
+	}
+
+	void SyntheticFrameSource::emitImu( uint64_t n )
+	{
+		if ( !_delegate ) return;
+		double t = n / double( _imuRate );
+		_delegate->handleNewSample( generateImu( ImuSample::Type::Accelerometer, t ) );
+		_delegate->handleNewSample( generateImu( ImuSample::Type::Gyroscope, t ) );
+	}
+
+	// generators
+
+	void SyntheticFrameSource::generateDepth( uint64_t n, DepthFrameData& frame ) const
+	{
+		frame.allocate( _depthW, _depthH, 1 );
+		frame.timestamp   = _depthRate > 0.f ? n / double( _depthRate ) : 0.;
+		frame.intrinsics  = _depthIntrinsics;
+		frame.visiblePose = visiblePose();
+
+		const float fx = _depthIntrinsics.fx, fy = _depthIntrinsics.fy;
+		const float cx = _depthIntrinsics.cx, cy = _depthIntrinsics.cy;
+
+		// sphere orbiting in front of the wall, one revolution every 4 seconds
+		const double angle = 2. * kPi * frame.timestamp / 4.;
+		const float sx = 400.f * float( std::cos( angle ) ), sy = 200.f * float( std::sin( angle ) ), sz = 1500.f;
+		const float sr = 300.f;
+		const float sc = sx * sx + sy * sy + sz * sz - sr * sr;
+
+		// wall: 0.2 * y + z = 2500
+		const float wallD = 2500.f;
+
+		const uint32_t dropThreshold = uint32_t( _options.invalidFraction * 4294967295.f );
+		const int border             = _depthW / 20;  // invalid band on the left, like the stereo shadow
+
+		float* px = frame.data();
+		for ( int r = 0; r < _depthH; ++r ) {
+			const float ry = ( r - cy ) / fy;
+			for ( int c = 0; c < _depthW; ++c, ++px ) {
+				if ( c < border || hash( c, r, uint32_t( n ) ) < dropThreshold ) {
+					*px = 0.f;
+					continue;
+				}
+				const float rx = ( c - cx ) / fx;
+				// ray (rx, ry, 1) * t, depth = t
+				float depth = wallD / ( 0.2f * ry + 1.f );
+				const float a    = rx * rx + ry * ry + 1.f;
+				const float b    = -2.f * ( rx * sx + ry * sy + sz );
+				const float disc = b * b - 4.f * a * sc;
+				if ( disc >= 0.f ) {
+					float t = ( -b - std::sqrt( disc ) ) / ( 2.f * a );
+					if ( t > 0.f && t < depth ) depth = t;
+				}
+				*px = std::round( depth * 4.f ) * 0.25f;  // quarter-mm steps, like the sensor
+			}
+		}
+	}
+
+	void SyntheticFrameSource::generateInfrared( uint64_t n, InfraredFrameData& frame ) const
+	{
+		const int w     = _options.infraredWidth;
+		const int h     = _options.infraredHeight;
+		const int sides = _irBothCameras ? 2 : 1;
+		frame.allocate( w * sides, h, 1 );
+		frame.timestamp  = _irRate > 0.f ? n / double( _irRate ) : 0.;
+		frame.intrinsics = _irIntrinsics;
+
+		// BothCameras rows are <right row r><left row r>, the left image is shifted by a fixed disparity
+		uint16_t* px = frame.data();
+		for ( int r = 0; r < h; ++r ) {
+			for ( int s = 0; s < sides; ++s ) {
+				const int shift = s == 1 ? 16 : 0;
+				for ( int c = 0; c < w; ++c, ++px ) {
+					uint32_t speckle = hash( uint32_t( c + shift ) / 2, uint32_t( r ) / 2, uint32_t( n / 8 ) ) >> 22;  // 0 - 1023
+					const float dx   = ( c - w * 0.5f ) / w, dy = ( r - h * 0.5f ) / h;
+					const float vignette = 1.f - ( dx * dx + dy * dy );
+					*px = uint16_t( speckle * vignette );
+				}
+			}
+		}
+	}
+
+	void SyntheticFrameSource::generateVisible( uint64_t n, VisibleFrameData& frame ) const
+	{
+		const int w = _options.visibleWidth;
+		const int h = _options.visibleHeight;
+		frame.timestamp  = _visibleRate > 0.f ? n / double( _visibleRate ) : 0.;
+		frame.intrinsics = _visibleIntrinsics;
+
+		const int bar = int( n * 4 % uint64_t( w ) );
+		auto color    = [&]( int r, int c, uint8_t* px ) {
+			const bool onBar = std::abs( c - bar ) < 8;
+			px[0]            = onBar ? 255 : uint8_t( c * 255 / w );
+			px[1]            = onBar ? 255 : uint8_t( r * 255 / h );
+			px[2]            = onBar ? 255 : uint8_t( 128 );
+		};
+
+		if ( !_visibleYCbCr ) {
+			frame.allocate( w, h, 3 );
+			uint8_t* px = frame.data();
+			for ( int r = 0; r < h; ++r ) {
+				for ( int c = 0; c < w; ++c, px += 3 ) color( r, c, px );
+			}
+			return;
+		}
+
+		// full range BT.601, chroma from the top left pixel of each 2x2 block
+		frame.allocateYCbCr( w, h );
+		uint8_t* luma   = frame.data();
+		uint8_t* chroma = frame.chroma();
+		uint8_t px[3];
+		for ( int r = 0; r < h; ++r ) {
+			for ( int c = 0; c < w; ++c ) {
+				color( r, c, px );
+				*luma++ = uint8_t( std::lround( 0.299 * px[0] + 0.587 * px[1] + 0.114 * px[2] ) );
+				if ( ( r | c ) & 1 ) continue;
+				*chroma++ = uint8_t( std::lround( 128. - 0.168736 * px[0] - 0.331264 * px[1] + 0.5 * px[2] ) );
+				*chroma++ = uint8_t( std::lround( 128. + 0.5 * px[0] - 0.418688 * px[1] - 0.081312 * px[2] ) );
+			}
+		}
+	}
+
+	ImuSample SyntheticFrameSource::generateImu( ImuSample::Type type, double t ) const
+	{
+		// roll back and forth +-10 degrees at 0.5 Hz around z
+		const double w     = 2. * kPi * 0.5;
+		const double amp   = 10. * kPi / 180.;
+		const double roll  = amp * std::sin( w * t );
+		const double noise = ( hash( uint32_t( t * 1000. ), uint32_t( type ), 0 ) / 4294967295. - 0.5 ) * 1e-3;
+
+		ImuSample s;
+		s.type             = type;
+		s.timestamp        = t;
+		s.arrivalTimestamp = t;
+		if ( type == ImuSample::Type::Accelerometer ) {
+			s.x = -std::sin( roll ) + noise;  // gravity, in g (turns against the sensor's roll)
+			s.y = -std::cos( roll ) + noise;
+			s.z = noise;
+		} else {
+			s.x = noise;  // d(roll)/dt, in rad/s
+			s.y = noise;
+			s.z = amp * w * std::cos( w * t ) + noise;
+		}
+		return s;
+	}
+
+	ST::Matrix4 SyntheticFrameSource::visiblePose()
+	{
+		// visible camera offset along x, so registration has a baseline to correct
+		ST::Matrix4 pose = ST::Matrix4::identity();
+		pose.m30         = 0.025f;  // m
+		return pose;
+	}
+
+	// utils
+
+	double SyntheticFrameSource::now() const
+	{
+		return std::chrono::duration<double>( std::chrono::steady_clock::now() - _start ).count();
+	}
+
+	uint32_t SyntheticFrameSource::hash( uint32_t x, uint32_t y, uint32_t n ) const
+	{
+		// integer mix, same output for the same inputs on every platform
+		uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ n * 0xcb1ab31fu ^ _options.seed * 0x165667b1u;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+}  // namespace structure
+}  // namespace ofx
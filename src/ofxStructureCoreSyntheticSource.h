@@ -0,0 +1,96 @@
+#pragma once
+#include "ofxStructureCoreFrameSource.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// deterministic stand-in for a Structure Core, no sensor or SDK library needed
+	// * depth: orbiting sphere in front of a tilted wall, with repeatable holes,
+	//   the visible camera sits 25 mm along x of the depth camera
+	// * infrared: speckle pattern (2x wide, row interleaved for IRMode::BothCameras)
+	// * visible: rgb gradient with a moving bar (or its luma + CbCr planes for Settings::addon.visibleYCbCr)
+	// * imu: gravity with a slow wobble, and the matching rotation rate
+	// * resolution, rates and enabled streams come from Settings::structureCore
+	// * frame content only depends on the frame index and seed,
+	//   sensor timestamps are frameIndex / framerate
+	// -----------------------------------------------------------------------
+
+	class SyntheticFrameSource : public FrameSource
+	{
+	public:
+		struct Options
+		{
+			bool realtime         = true;  // pace streams at their framerates, false = as fast as possible
+			int infraredWidth     = 1280;  // per camera
+			int infraredHeight    = 960;
+			int visibleWidth      = 640;
+			int visibleHeight     = 480;
+			float invalidFraction = 0.1f;  // fraction of depth pixels dropped to 0
+			uint32_t seed         = 1;
+		};
+
+		SyntheticFrameSource();
+		SyntheticFrameSource( const Options& options );
+		~SyntheticFrameSource();
+
+		bool setup( const Settings& settings ) override;
+		bool startStreaming() override;
+		void stopStreaming() override;
+		std::string serial() const override { return "synthetic"; }
+		double now() const override;  // seconds since setup() / startStreaming(), the clock of the frame + imu timestamps
+		ST::Matrix4 imuFromVisible() const override { return visiblePose(); }  // the imu sits at the depth camera
+
+		// generate + deliver the next frame of each enabled stream (and the imu samples leading up to it)
+		// on the calling thread, for benchmarks -- don't mix with startStreaming()
+		void step();
+
+		const Options& options() const { return _options; }
+		uint64_t frameIndex() const { return _frameIndex; }
+
+		// generators, exposed so benchmarks can build input without a delegate
+		void generateDepth( uint64_t n, DepthFrameData& frame ) const;
+		void generateInfrared( uint64_t n, InfraredFrameData& frame ) const;
+		void generateVisible( uint64_t n, VisibleFrameData& frame ) const;
+		ImuSample generateImu( ImuSample::Type type, double t ) const;
+
+		// visible camera in depth coordinates, as set on every depth frame
+		static ST::Matrix4 visiblePose();
+
+	protected:
+		Options _options;
+
+		bool _depthEnabled = true, _irEnabled = true, _visibleEnabled = true, _imuEnabled = false;
+		bool _irBothCameras  = true;
+		bool _visibleYCbCr   = false;
+		int _depthW          = 640, _depthH = 480;
+		float _depthRate     = 30.f, _irRate = 30.f, _visibleRate = 30.f, _imuRate = 800.f;
+		ST::Intrinsics _depthIntrinsics, _irIntrinsics, _visibleIntrinsics;
+
+		// output frames, reused once the delegate lets go of them
+		FramePool<DepthFrameData> _depthFrames;
+		FramePool<InfraredFrameData> _irFrames;
+		FramePool<VisibleFrameData> _visibleFrames;
+
+		uint64_t _frameIndex = 0;
+		uint64_t _imuIndex   = 0;
+
+		std::atomic<bool> _streaming{false};
+		std::chrono::steady_clock::time_point _start;  // realtime: frame k of a stream is due at _start + k / rate
+		std::thread _frameThread, _imuThread;
+		void frameLoop();
+		void imuLoop();
+
+		void emitDepth( uint64_t n );
+		void emitInfrared( uint64_t n );
+		void emitVisible( uint64_t n );
+		void emitImu( uint64_t n );
+
+		uint32_t hash( uint32_t x, uint32_t y, uint32_t n ) const;
+	};
+
+}  // namespace structure
+}  // namespace ofx
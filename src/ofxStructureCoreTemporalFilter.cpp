@@ -0,0 +1,151 @@
+#include "ofxStructureCoreTemporalFilter.h"
+#include "ofMain.h"
+#include "ofxStructureCoreSimd.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+
+		struct TemporalConstants
+		{
+			float alpha, oneMinusAlpha, invThreshold;
+			int hold;
+
+			explicit TemporalConstants( const TemporalFilterParams& params )
+			{
+				alpha         = std::min( std::max( params.alpha, 0.f ), 1.f );
+				oneMinusAlpha = 1.f - alpha;
+				invThreshold  = 1.f / std::max( params.motionThreshold, 1e-3f );
+				hold          = std::min( std::max( params.holdFrames, 0 ), 255 );
+			}
+		};
+
+		inline float temporalStep( float d, float& s, uint8_t& age, const TemporalConstants& k )
+		{
+			const float prev = s;
+			if ( d > 0.f ) {
+				if ( prev > 0.f ) {
+					const float diff = d - prev;
+					float t          = std::fabs( diff ) * k.invThreshold;
+					t                = t < 1.f ? t : 1.f;  // same as _mm_min_ps
+					s                = prev + ( k.alpha + t * k.oneMinusAlpha ) * diff;
+				} else {
+					s = d;  // nothing to blend with
+				}
+				age = 0;
+			} else if ( prev > 0.f && age < k.hold ) {
+				++age;  // hold the last value
+			} else {
+				s = 0.f;
+			}
+			return s;
+		}
+
+		void temporalRowsScalar( const TemporalConstants& k, float* d, float* s, uint8_t* age, size_t n )
+		{
+			for ( size_t i = 0; i < n; ++i ) d[i] = temporalStep( d[i], s[i], age[i], k );
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		inline __m128 select( __m128 mask, __m128 a, __m128 b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+
+		// 16 pixels per step, one load / store of their ages
+		void temporalRowsSSE2( const TemporalConstants& k, float* d, float* s, uint8_t* age, size_t n )
+		{
+			const __m128 zero          = _mm_setzero_ps();
+			const __m128 one           = _mm_set1_ps( 1.f );
+			const __m128 absMask       = _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) );
+			const __m128 alpha         = _mm_set1_ps( k.alpha );
+			const __m128 oneMinusAlpha = _mm_set1_ps( k.oneMinusAlpha );
+			const __m128 invThreshold  = _mm_set1_ps( k.invThreshold );
+			const __m128i hold         = _mm_set1_epi32( k.hold );
+			const __m128i zeroi        = _mm_setzero_si128();
+			size_t i                   = 0;
+			for ( ; i + 16 <= n; i += 16 ) {
+				const __m128i ages8  = _mm_loadu_si128( ( const __m128i* )( age + i ) );
+				const __m128i agesLo = _mm_unpacklo_epi8( ages8, zeroi );
+				const __m128i agesHi = _mm_unpackhi_epi8( ages8, zeroi );
+				__m128i ages[4]      = {_mm_unpacklo_epi16( agesLo, zeroi ), _mm_unpackhi_epi16( agesLo, zeroi ), _mm_unpacklo_epi16( agesHi, zeroi ), _mm_unpackhi_epi16( agesHi, zeroi )};
+				for ( int j = 0; j < 4; ++j ) {
+					float* dj          = d + i + 4 * j;
+					float* sj          = s + i + 4 * j;
+					const __m128 depth = _mm_loadu_ps( dj );
+					const __m128 prev  = _mm_loadu_ps( sj );
+					const __m128 valid = _mm_cmpgt_ps( depth, zero );
+					const __m128 diff  = _mm_sub_ps( depth, prev );
+					const __m128 t     = _mm_min_ps( _mm_mul_ps( _mm_and_ps( diff, absMask ), invThreshold ), one );
+					const __m128 blend = _mm_add_ps( prev, _mm_mul_ps( _mm_add_ps( alpha, _mm_mul_ps( t, oneMinusAlpha ) ), diff ) );
+					const __m128 had   = _mm_cmpgt_ps( prev, zero );
+					const __m128i keep = _mm_and_si128( _mm_castps_si128( had ), _mm_cmplt_epi32( ages[j], hold ) );
+					const __m128 next  = select( valid, select( had, blend, depth ), _mm_and_ps( _mm_castsi128_ps( keep ), prev ) );
+					// measured: 0, held: + 1 (keep is -1), dropped: unchanged
+					ages[j] = _mm_andnot_si128( _mm_castps_si128( valid ), _mm_sub_epi32( ages[j], _mm_andnot_si128( _mm_castps_si128( valid ), keep ) ) );
+					_mm_storeu_ps( sj, next );
+					_mm_storeu_ps( dj, next );
+				}
+				// ages are <= 255, so the saturating packs don't clip
+				_mm_storeu_si128( ( __m128i* )( age + i ), _mm_packus_epi16( _mm_packs_epi32( ages[0], ages[1] ), _mm_packs_epi32( ages[2], ages[3] ) ) );
+			}
+			temporalRowsScalar( k, d + i, s + i, age + i, n - i );
+		}
+#endif
+
+	}  // namespace
+
+	void applyTemporalFilterScalar( const TemporalFilterParams& params, float* depths, float* state, uint8_t* age, int width, int rowBegin, int rowEnd )
+	{
+		const size_t begin = size_t( rowBegin ) * width;
+		temporalRowsScalar( TemporalConstants( params ), depths + begin, state + begin, age + begin, size_t( rowEnd - rowBegin ) * width );
+	}
+
+	void applyTemporalFilter( const TemporalFilterParams& params, float* depths, float* state, uint8_t* age, int width, int rowBegin, int rowEnd )
+	{
+		const size_t begin = size_t( rowBegin ) * width;
+		const size_t n     = size_t( rowEnd - rowBegin ) * width;
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: temporalRowsSSE2( TemporalConstants( params ), depths + begin, state + begin, age + begin, n ); return;  // memory bound, sse2 is enough
+#endif
+			default: temporalRowsScalar( TemporalConstants( params ), depths + begin, state + begin, age + begin, n ); return;
+		}
+	}
+
+	// -----------------------------------------------------------------------
+
+	void TemporalFilter::apply( float* depths, int width, int height, ThreadPool& pool )
+	{
+		if ( !params.enabled ) {
+			_width = _height = 0;  // start over when enabled again
+			_micros          = 0;
+			return;
+		}
+		uint64_t t0 = ofGetElapsedTimeMicros();
+		if ( width != _width || height != _height ) {
+			_width  = width;
+			_height = height;
+			reset();
+		}
+		pool.parallelFor( 0, height, 16, [&]( size_t b, size_t e ) {
+			applyTemporalFilter( params, depths, _state.data(), _age.data(), width, int( b ), int( e ) );
+		} );
+		_micros = ofGetElapsedTimeMicros() - t0;
+	}
+
+	void TemporalFilter::reset()
+	{
+		const size_t n = size_t( _width ) * _height;
+		_state.assign( n, 0.f );
+		_age.assign( n, 0 );
+	}
+
+}  // namespace structure
+}  // namespace ofx
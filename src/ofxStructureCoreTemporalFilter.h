@@ -0,0 +1,54 @@
+#pragma once
+#include "ofxStructureCoreThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// per pixel temporal depth filter, run on depthImg after the spatial filters
+	// * exponential smoothing: s += a * ( d - s )
+	// * motion adaptive: a ramps from alpha up to 1 as | d - s | approaches motionThreshold,
+	//   so moving surfaces follow the new frame instead of smearing
+	// * persistence: a pixel that drops out keeps its last value for up to holdFrames frames
+	// -----------------------------------------------------------------------
+
+	struct TemporalFilterParams
+	{
+		bool enabled          = false;
+		float alpha           = 0.4f;  // weight of the new frame for a still surface, 0 - 1 (1 = no smoothing)
+		float motionThreshold = 50.f;  // mm, depth changes at or above this use the new frame as is
+		int holdFrames        = 2;     // frames a missing pixel keeps its last value, 0 - 255 (0 = holes show right away)
+	};
+
+	// one step for rows [rowBegin, rowEnd): depths in, filtered depths out (in place)
+	// state is the smoothed depth (0 = none), age counts the frames since the pixel was last measured
+	// dispatches to the best kernel for getSimdLevel(), all kernels match the scalar loop bit for bit
+	void applyTemporalFilter( const TemporalFilterParams& params, float* depths, float* state, uint8_t* age, int width, int rowBegin, int rowEnd );
+	void applyTemporalFilterScalar( const TemporalFilterParams& params, float* depths, float* state, uint8_t* age, int width, int rowBegin, int rowEnd );
+
+	// -----------------------------------------------------------------------
+
+	class TemporalFilter
+	{
+	public:
+		// can be changed any time between apply() calls
+		TemporalFilterParams params;
+
+		// filters depths in place if params.enabled, state is kept between calls and restarts when the size changes
+		void apply( float* depths, int width, int height, ThreadPool& pool );
+		void reset();  // forget the history, e.g. after the sensor moved
+
+		// microseconds the last apply() took
+		uint64_t getMicros() const { return _micros; }
+
+	protected:
+		int _width = 0, _height = 0;
+		std::vector<float> _state;
+		std::vector<uint8_t> _age;
+		uint64_t _micros = 0;
+	};
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,127 @@
+#include "ofxStructureCoreThreadPool.h"
+#include <algorithm>
+
+#if defined( _WIN32 )
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+		thread_local const ThreadPool* insideJob = nullptr;  // pool whose job this thread is running
+	}
+
+	ThreadPool::ThreadPool( size_t threads, const std::vector<int>& affinity )
+	{
+		if ( threads == 0 ) {
+			threads = std::max( 1u, std::thread::hardware_concurrency() );
+		}
+		for ( size_t i = 0; i + 1 < threads; ++i ) {
+			_workers.emplace_back( &ThreadPool::workerLoop, this );
+			if ( !affinity.empty() ) {
+				pin( _workers.back(), affinity[i % affinity.size()] );
+			}
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			_quit = true;
+		}
+		_wake.notify_all();
+		for ( auto& worker : _workers ) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::run( size_t begin, size_t end, size_t grain, const Job& fn )
+	{
+		if ( end <= begin ) return;
+		const size_t n = end - begin;
+		grain          = std::max<size_t>( grain, 1 );
+		// busy with another thread's job (e.g. called back from a pool that job is waiting on): no workers to spare
+		if ( _workers.empty() || insideJob == this || n <= grain || _running.exchange( true, std::memory_order_acquire ) ) {
+			fn( begin, end );
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lck( _lock );
+			_job       = &fn;
+			_begin     = begin;
+			_end       = end;
+			_numChunks = std::min( ( n + grain - 1 ) / grain, size() * 4 );  // a few chunks per thread to balance load
+			_chunk     = ( n + _numChunks - 1 ) / _numChunks;
+			_nextChunk = 0;
+			++_generation;
+		}
+		_wake.notify_all();
+
+		const ThreadPool* outer = insideJob;  // a job on another pool (e.g. one sensor of a group)
+		insideJob               = this;
+		runChunks();
+		insideJob = outer;
+
+		// wait for workers to leave the job before its state goes away
+		std::unique_lock<std::mutex> lck( _lock );
+		_done.wait( lck, [this]() { return _busy == 0; } );
+		_job = nullptr;
+		_running.store( false, std::memory_order_release );
+	}
+
+	void ThreadPool::runChunks()
+	{
+		for ( size_t i = _nextChunk++; i < _numChunks; i = _nextChunk++ ) {
+			size_t b = _begin + i * _chunk;
+			size_t e = std::min( _end, b + _chunk );
+			if ( b < e ) ( *_job )( b, e );
+		}
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		uint64_t seen = 0;
+		insideJob     = this;  // jobs never spawn nested jobs on this pool's workers
+		while ( true ) {
+			{
+				std::unique_lock<std::mutex> lck( _lock );
+				_wake.wait( lck, [&]() { return _quit || ( _generation != seen && _job ); } );
+				if ( _quit ) return;
+				seen = _generation;
+				++_busy;
+			}
+			runChunks();
+			{
+				std::unique_lock<std::mutex> lck( _lock );
+				--_busy;
+			}
+			_done.notify_one();
+		}
+	}
+
+	void ThreadPool::pin( std::thread& thread, int cpu )
+	{
+#if defined( _WIN32 )
+		SetThreadAffinityMask( thread.native_handle(), DWORD_PTR( 1 ) << cpu );
+#elif defined( __linux__ )
+		cpu_set_t set;
+		CPU_ZERO( &set );
+		CPU_SET( cpu, &set );
+		pthread_setaffinity_np( thread.native_handle(), sizeof( set ), &set );
+#else
+		( void )thread;
+		( void )cpu;  // no thread affinity api on macOS
+#endif
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// fixed pool of workers for splitting per-frame work (rows, points) across cores
+	// * parallelFor() blocks, the calling thread works too
+	// * work is split into contiguous, non-overlapping chunks, so kernels that only
+	//   write their own range give the same output for any thread count
+	// * not re-entrant: parallelFor() from inside one of its own jobs, or while another thread's
+	//   job is running, runs inline -- from inside another pool's job it splits as usual
+	// -----------------------------------------------------------------------
+
+	class ThreadPool
+	{
+	public:
+		// threads: total incl. the caller (0 = hardware concurrency)
+		// affinity: cpu ids workers are pinned to, round robin (empty = no pinning)
+		explicit ThreadPool( size_t threads = 0, const std::vector<int>& affinity = {} );
+		~ThreadPool();
+
+		ThreadPool( const ThreadPool& ) = delete;
+		ThreadPool& operator=( const ThreadPool& ) = delete;
+
+		size_t size() const { return _workers.size() + 1; }
+
+		// fn( size_t begin, size_t end ) is called once per chunk, at least grain items each
+		template <typename Fn>
+		void parallelFor( size_t begin, size_t end, size_t grain, const Fn& fn )
+		{
+			Job job{&fn, []( const void* f, size_t b, size_t e ) { ( *static_cast<const Fn*>( f ) )( b, e ); }};
+			run( begin, end, grain, job );
+		}
+
+	protected:
+		// non-owning callable, so handing a lambda over doesn't allocate (unlike std::function)
+		struct Job
+		{
+			const void* fn;
+			void ( *call )( const void* fn, size_t begin, size_t end );
+			void operator()( size_t begin, size_t end ) const { call( fn, begin, end ); }
+		};
+		void run( size_t begin, size_t end, size_t grain, const Job& job );
+
+		std::vector<std::thread> _workers;
+
+		std::mutex _lock;
+		std::condition_variable _wake, _done;
+		uint64_t _generation = 0;
+		size_t _busy         = 0;  // workers inside the current job
+		bool _quit           = false;
+		std::atomic<bool> _running{false};  // a caller's job is in flight
+
+		// current job
+		const Job* _job   = nullptr;
+		size_t _begin     = 0;
+		size_t _end       = 0;
+		size_t _chunk     = 0;
+		size_t _numChunks = 0;
+		std::atomic<size_t> _nextChunk{0};
+
+		void workerLoop();
+		void runChunks();
+		static void pin( std::thread& thread, int cpu );
+	};
+
+}  // namespace structure
+}  // namespace ofx
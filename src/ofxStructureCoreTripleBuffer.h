@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	struct FrameStats
+	{
+		uint64_t published = 0;  // frames written by the producer
+		uint64_t consumed  = 0;  // frames picked up by the consumer
+		uint64_t dropped   = 0;  // frames overwritten before the consumer picked them up
+	};
+
+	// -----------------------------------------------------------------------
+	// lock-free single producer / single consumer triple buffer
+	// * producer (SDK thread) fills back(), then publish() swaps it into the middle slot
+	// * consumer (app thread) calls consume() to swap the newest published slot to front()
+	// * neither side ever blocks, and the consumer always gets the latest complete frame
+	// -----------------------------------------------------------------------
+
+	template <typename T>
+	class TripleBuffer
+	{
+	public:
+		using Stats = FrameStats;
+
+		// producer side
+
+		T& back() { return _slots[_back]; }
+
+		void publish()
+		{
+			int prev = _middle.exchange( _back | kNewBit, std::memory_order_acq_rel );
+			_back    = prev & kIndexMask;
+			_published.fetch_add( 1, std::memory_order_relaxed );
+			if ( prev & kNewBit ) {
+				_dropped.fetch_add( 1, std::memory_order_relaxed );  // consumer never saw it
+			}
+		}
+
+		// consumer side
+
+		bool hasNew() const { return _middle.load( std::memory_order_acquire ) & kNewBit; }
+
+		// swap in the newest frame, returns false if nothing new was published
+		bool consume()
+		{
+			if ( !hasNew() ) {
+				return false;
+			}
+			int prev = _middle.exchange( _front, std::memory_order_acq_rel );
+			_front   = prev & kIndexMask;
+			_consumed.fetch_add( 1, std::memory_order_relaxed );
+			return true;
+		}
+
+		const T& front() const { return _slots[_front]; }
+		T& front() { return _slots[_front]; }
+
+		Stats stats() const
+		{
+			Stats s;
+			s.published = _published.load( std::memory_order_relaxed );
+			s.consumed  = _consumed.load( std::memory_order_relaxed );
+			s.dropped   = _dropped.load( std::memory_order_relaxed );
+			return s;
+		}
+
+	protected:
+		static constexpr int kIndexMask = 0x3;
+		static constexpr int kNewBit    = 0x4;
+
+		std::array<T, 3> _slots;
+		int _back  = 0;                // owned by producer
+		int _front = 1;                // owned by consumer
+		std::atomic<int> _middle{2};  // shared, index | kNewBit
+
+		std::atomic<uint64_t> _published{0}, _consumed{0}, _dropped{0};
+	};
+
+}  // namespace structure
+}  // namespace ofx
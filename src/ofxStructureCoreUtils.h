@@ -10,7 +10,7 @@ namespace structure {
 	// -----------------------------------------------------------------------
 	// point cloud from depth image
 	// * transform vertices from depth image
-	// * uses camera instrinsics cx, cy, fx, fy (as vec2 uC, uF)
+	// * uses cached unprojection rays (see RayTable): uRayTex row 0 = x ray per column, row 1 = y ray per row
 	// -----------------------------------------------------------------------
 
 	// oF input
@@ -21,9 +21,10 @@ namespace structure {
 
 	// custom input
 
-	uniform sampler2DRect uDepthTex;		// depth data - GL_R16 / unsigned short millimeters
+	uniform sampler2DRect uDepthTex;		// depth data - GL_R32F millimeters, or GL_R16 / unsigned short millimeters (normalized)
+	uniform float uDepthScale;				// 1 for GL_R32F, 65535 for GL_R16
 	uniform ivec2 uDepthDims;				// texture dims
-	uniform vec2 uC, uF;					// camera intrinsics: cx,cy,fx,fy
+	uniform sampler2DRect uRayTex;			// rays - GL_R32F, ( c - cx ) / fx and ( r - cy ) / fy
 
 	out vec3 vPosition;
 	out vec2 vTexCoord;
@@ -41,11 +42,12 @@ namespace structure {
 		// our texture coordinate in the depth frame
 		vTexCoord	= vec2(gl_VertexID % uDepthDims.x, gl_VertexID / uDepthDims.x);
 
-		float depth	= texture(uDepthTex, vTexCoord).r; // * 65535.0;		// Remap 0-1 to float range (millimeters)
+		float depth	= texture(uDepthTex, vTexCoord).r * uDepthScale;		// Remap 0-1 to millimeters for GL_R16
+		depth		= uDepthScale == 1. ? depth : floor( depth + .5 );	// GL_R16: whole millimeters, like the cpu path
 
 		// project depth image into metric space using depth cam intrinsics
 		// see: http://nicolas.burrus.name/index.php/Research/KinectCalibration
-		vec2 ray = ( vTexCoord - uC ) / uF;
+		vec2 ray = vec2( texelFetch( uRayTex, ivec2( vTexCoord.x, 0 ) ).r, texelFetch( uRayTex, ivec2( vTexCoord.y, 1 ) ).r );
 		vec3 pos = vec3( ray, 1. ) * depth;
 
 		// flag invalid data (0 depth)
@@ -0,0 +1,104 @@
+#include "ofxStructureCoreYCbCr.h"
+#include "ofxStructureCoreSimd.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OFX_STRUCTURE_X64
+#include <immintrin.h>
+#endif
+
+namespace ofx {
+namespace structure {
+
+	namespace {
+
+		// full range BT.601 * 2^14, all fit in int16 for _mm_madd_epi16
+		const int kCrToR = 22970;   //  1.402
+		const int kCbToG = -5638;   // -0.344136
+		const int kCrToG = -11700;  // -0.714136
+		const int kCbToB = 29032;   //  1.772
+		const int kRound = 1 << 13;
+
+		inline uint8_t clamp8( int v ) { return uint8_t( v < 0 ? 0 : ( v > 255 ? 255 : v ) ); }
+
+		// pixels [c, width) of one row
+		inline void convertPixels( const uint8_t* y, const uint8_t* cbcr, uint8_t* out, int c, int width )
+		{
+			for ( ; c < width; ++c ) {
+				const int cb = cbcr[( c >> 1 ) * 2] - 128;
+				const int cr = cbcr[( c >> 1 ) * 2 + 1] - 128;
+				const int l  = y[c];
+				out[c * 3]     = clamp8( l + ( ( kCrToR * cr + kRound ) >> 14 ) );  // arithmetic shift, like _mm_srai_epi32
+				out[c * 3 + 1] = clamp8( l + ( ( kCbToG * cb + kCrToG * cr + kRound ) >> 14 ) );
+				out[c * 3 + 2] = clamp8( l + ( ( kCbToB * cb + kRound ) >> 14 ) );
+			}
+		}
+
+#ifdef OFX_STRUCTURE_X64
+		// 8 pixels (4 CbCr pairs) of one channel: y + ( madd( cbcr, k ) + round ) >> 14, as int16
+		inline __m128i channel8( __m128i y16, __m128i cbcr16, __m128i k )
+		{
+			const __m128i round = _mm_set1_epi32( kRound );
+			const __m128i d     = _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( cbcr16, k ), round ), 14 );  // one per pair
+			const __m128i lo    = _mm_add_epi32( _mm_unpacklo_epi16( y16, _mm_setzero_si128() ), _mm_unpacklo_epi32( d, d ) );
+			const __m128i hi    = _mm_add_epi32( _mm_unpackhi_epi16( y16, _mm_setzero_si128() ), _mm_unpackhi_epi32( d, d ) );
+			return _mm_packs_epi32( lo, hi );
+		}
+
+		// 16 pixels per step, the packs saturate to 0 - 255 like clamp8()
+		void convertRowSSE2( const uint8_t* y, const uint8_t* cbcr, uint8_t* out, int width )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16( 128 );
+			const __m128i kR   = _mm_set1_epi32( ( kCrToR << 16 ) );  // ( cb, cr ) pairs: low 16 bits cb, high cr
+			const __m128i kG   = _mm_set1_epi32( int( ( uint32_t( kCrToG ) << 16 ) | uint16_t( kCbToG ) ) );
+			const __m128i kB   = _mm_set1_epi32( kCbToB );
+			alignas( 16 ) uint8_t r[16], g[16], b[16];
+			int c = 0;
+			for ( ; c + 16 <= width; c += 16 ) {
+				const __m128i y8    = _mm_loadu_si128( ( const __m128i* )( y + c ) );
+				const __m128i cbcr8 = _mm_loadu_si128( ( const __m128i* )( cbcr + c ) );  // 8 pairs
+				const __m128i yLo   = _mm_unpacklo_epi8( y8, zero );
+				const __m128i yHi   = _mm_unpackhi_epi8( y8, zero );
+				const __m128i cLo   = _mm_sub_epi16( _mm_unpacklo_epi8( cbcr8, zero ), bias );
+				const __m128i cHi   = _mm_sub_epi16( _mm_unpackhi_epi8( cbcr8, zero ), bias );
+				_mm_store_si128( ( __m128i* )r, _mm_packus_epi16( channel8( yLo, cLo, kR ), channel8( yHi, cHi, kR ) ) );
+				_mm_store_si128( ( __m128i* )g, _mm_packus_epi16( channel8( yLo, cLo, kG ), channel8( yHi, cHi, kG ) ) );
+				_mm_store_si128( ( __m128i* )b, _mm_packus_epi16( channel8( yLo, cLo, kB ), channel8( yHi, cHi, kB ) ) );
+				uint8_t* o = out + c * 3;
+				for ( int k = 0; k < 16; ++k, o += 3 ) {
+					o[0] = r[k], o[1] = g[k], o[2] = b[k];  // sse2 has no byte shuffle to interleave with
+				}
+			}
+			convertPixels( y, cbcr, out, c, width );
+		}
+#endif
+
+	}  // namespace
+
+	void yCbCrToRgbScalar( const uint8_t* luma, const uint8_t* chroma, int width, uint8_t* rgb, int rowBegin, int rowEnd )
+	{
+		const size_t chromaStride = size_t( ( width + 1 ) / 2 ) * 2;
+		for ( int r = rowBegin; r < rowEnd; ++r ) {
+			convertPixels( luma + size_t( r ) * width, chroma + size_t( r / 2 ) * chromaStride, rgb + size_t( r ) * width * 3, 0, width );
+		}
+	}
+
+	void yCbCrToRgb( const uint8_t* luma, const uint8_t* chroma, int width, uint8_t* rgb, int rowBegin, int rowEnd )
+	{
+		switch ( getSimdLevel() ) {
+#ifdef OFX_STRUCTURE_X64
+			case SimdLevel::AVX2:
+			case SimdLevel::SSE2: {
+				const size_t chromaStride = size_t( ( width + 1 ) / 2 ) * 2;
+				for ( int r = rowBegin; r < rowEnd; ++r ) {
+					convertRowSSE2( luma + size_t( r ) * width, chroma + size_t( r / 2 ) * chromaStride, rgb + size_t( r ) * width * 3, width );
+				}
+				return;
+			}
+#endif
+			default: yCbCrToRgbScalar( luma, chroma, width, rgb, rowBegin, rowEnd ); return;
+		}
+	}
+
+}  // namespace structure
+}  // namespace ofx
@@ -0,0 +1,33 @@
+#pragma once
+#include "ofxStructureCoreThreadPool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace ofx {
+namespace structure {
+
+	// -----------------------------------------------------------------------
+	// planar YCbCr visible frames (Settings::addon.visibleYCbCr)
+	// * a width * height luma plane, then interleaved CbCr at half width and height (4:2:0)
+	// * converted to rgb only on demand, full range BT.601 in 14 bit fixed point
+	// -----------------------------------------------------------------------
+
+	// bytes of the CbCr plane for a width * height frame
+	inline size_t chromaSize( int width, int height ) { return size_t( ( width + 1 ) / 2 ) * ( ( height + 1 ) / 2 ) * 2; }
+
+	// dispatches to the best kernel for getSimdLevel(), all kernels match the scalar loop bit for bit
+	// rows [rowBegin, rowEnd) of rgb (3 bytes per pixel) only
+	void yCbCrToRgb( const uint8_t* luma, const uint8_t* chroma, int width, uint8_t* rgb, int rowBegin, int rowEnd );
+	void yCbCrToRgbScalar( const uint8_t* luma, const uint8_t* chroma, int width, uint8_t* rgb, int rowBegin, int rowEnd );
+
+	// row pairs (one chroma row each) split across the pool
+	inline void yCbCrToRgb( const uint8_t* luma, const uint8_t* chroma, int width, int height, uint8_t* rgb, ThreadPool& pool )
+	{
+		pool.parallelFor( 0, size_t( height + 1 ) / 2, 8, [&]( size_t b, size_t e ) {
+			yCbCrToRgb( luma, chroma, width, rgb, int( b * 2 ), std::min( int( e * 2 ), height ) );
+		} );
+	}
+
+}  // namespace structure
+}  // namespace ofx